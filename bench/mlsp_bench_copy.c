@@ -0,0 +1,111 @@
+/*
+ * MLSP Minimal Latency Streaming Protocol payload copy benchmark
+ *
+ * Copyright 2019-2020 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Compares libc memcpy with streaming store copy (nontemporal in mlsp_config)
+ * placing packet payloads into frame buffers of growing size, like mlsp_receive.
+ *
+ * For each frame buffer size reports:
+ * - placement throughput of both copies
+ * - time to read back consumer working set afterwards (cache pollution)
+ *
+ * Usage: mlsp-bench-copy [working set KiB, default 512]
+ */
+
+//internal copy routines are static, benchmark is built with library source
+#include "../mlsp.c"
+
+enum {BENCH_BYTES = 1 << 30, MAX_FRAME_SIZE = 64 << 20};
+
+static volatile uint64_t bench_sink; //keeps working set reads
+
+static double bench_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//sums working set so that it has to be read, returns read time in us
+static double bench_read(const uint64_t *set, size_t size, uint64_t *sum)
+{
+	const double start = bench_seconds();
+
+	for(size_t i=0;i<size/sizeof(uint64_t);i+=8)
+		*sum += set[i];
+
+	return (bench_seconds() - start) * 1e6;
+}
+
+//places frame in PACKET_MAX_PAYLOAD chunks, returns GB/s and average working set read time in us
+static double bench_place(mlsp_copy_function copy, uint8_t *frame, size_t frame_size, const uint8_t *packet,
+	const uint64_t *set, size_t set_size, double *read_us)
+{
+	const int rounds = BENCH_BYTES / frame_size > 0 ? BENCH_BYTES / frame_size : 1;
+	double copy_s = 0, total_read_us = 0;
+	uint64_t sum = 0;
+
+	for(int r=0;r<rounds;++r)
+	{
+		bench_read(set, set_size, &sum); //consumer data hot in cache
+
+		const double start = bench_seconds();
+
+		for(size_t offset=0;offset + PACKET_MAX_PAYLOAD <= frame_size;offset += PACKET_MAX_PAYLOAD)
+			copy(frame + offset, packet, PACKET_MAX_PAYLOAD);
+
+		copy_s += bench_seconds() - start;
+		total_read_us += bench_read(set, set_size, &sum);
+	}
+
+	bench_sink = sum;
+	*read_us = total_read_us / rounds;
+
+	return (double)frame_size * rounds / copy_s / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	const size_t set_size = (argc > 1 ? (size_t)atoi(argv[1]) : 512) * 1024;
+	const mlsp_copy_function nontemporal = mlsp_copy_select(1);
+	uint8_t *frame = malloc(MAX_FRAME_SIZE + BUFFER_PADDING_SIZE);
+	uint64_t *set = malloc(set_size);
+	uint8_t packet[PACKET_MAX_PAYLOAD];
+
+	if(frame == NULL || set == NULL || set_size == 0)
+	{
+		fprintf(stderr, "mlsp-bench-copy: not enough memory\n");
+		return 1;
+	}
+
+	memset(packet, 0x5a, sizeof(packet));
+	memset(frame, 0, MAX_FRAME_SIZE);
+	memset(set, 1, set_size);
+
+	if(nontemporal == memcpy)
+		fprintf(stderr, "mlsp-bench-copy: streaming stores not available, both columns use memcpy\n");
+
+	printf("%10s %14s %14s %16s %16s\n", "frame KiB", "memcpy GB/s", "stream GB/s", "memcpy read us", "stream read us");
+
+	for(size_t frame_size=64 << 10;frame_size<=MAX_FRAME_SIZE;frame_size*=4)
+	{
+		double memcpy_read_us, stream_read_us;
+		const double memcpy_gbs = bench_place(memcpy, frame, frame_size, packet, set, set_size, &memcpy_read_us);
+		const double stream_gbs = bench_place(nontemporal, frame, frame_size, packet, set, set_size, &stream_read_us);
+
+		printf("%10zu %14.2f %14.2f %16.1f %16.1f\n", frame_size >> 10, memcpy_gbs, stream_gbs, memcpy_read_us, stream_read_us);
+	}
+
+	free(frame);
+	free(set);
+
+	return 0;
+}
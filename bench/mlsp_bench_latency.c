@@ -0,0 +1,191 @@
+/*
+ * MLSP Minimal Latency Streaming Protocol receive latency benchmark
+ *
+ * Copyright 2019-2020 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Packet to delivery latency over loopback for blocking, spinning
+ * and busy polling receiver (spin_us, busy_poll_us in mlsp_config).
+ *
+ * Sender thread sends single packet frames stamped with send time at fixed
+ * interval, so that blocking receiver goes to sleep between frames.
+ * Receiver measures time from stamp to mlsp_receive return.
+ *
+ * Usage: mlsp-bench-latency [frames, default 10000] [interval us, default 200] [receiver cpu, default not pinned]
+ */
+
+#include "../mlsp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+enum {BENCH_PORT = 9790, BENCH_FRAME_SIZE = 200};
+
+struct bench_mode
+{
+	const char *name;
+	int spin_us;
+	int busy_poll_us;
+};
+
+struct bench_receiver
+{
+	struct mlsp_config config;
+	int frames;
+	int received;
+	uint64_t *latency_us;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int ready; //1 initialized, -1 failed
+};
+
+static uint64_t bench_realtime_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void bench_ready(struct bench_receiver *r, int ready)
+{
+	pthread_mutex_lock(&r->mutex);
+	r->ready = ready;
+	pthread_cond_signal(&r->cond);
+	pthread_mutex_unlock(&r->mutex);
+}
+
+//server is initialized in receiving thread, pin_cpu applies to it
+static void *bench_receive(void *arg)
+{
+	struct bench_receiver *r = (struct bench_receiver*)arg;
+	struct mlsp *m = mlsp_init_server(&r->config);
+	const struct mlsp_frame *frame;
+	int error;
+
+	bench_ready(r, m ? 1 : -1);
+
+	if(m == NULL)
+		return NULL;
+
+	while(r->received < r->frames)
+	{
+		if( (frame = mlsp_receive(m, &error)) == NULL )
+		{
+			if(error == MLSP_TIMEOUT)
+				break; //sender finished, lost frames are not counted
+			continue;
+		}
+		r->latency_us[r->received++] = bench_realtime_us() - frame[0].timestamp;
+	}
+
+	mlsp_close(m);
+	return NULL;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+	const uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+static int bench_mode(const struct bench_mode *mode, int port, int frames, int interval_us, int cpu)
+{
+	struct bench_receiver r = {{0}};
+	struct mlsp_config client_config = {"127.0.0.1", (uint16_t)port};
+	struct timespec interval = {0, interval_us * 1000L};
+	uint8_t data[BENCH_FRAME_SIZE] = {0};
+	struct mlsp_frame frame = {data, sizeof(data)};
+	pthread_t thread;
+	struct mlsp *m;
+
+	r.config.port = port;
+	r.config.timeout_ms = 500;
+	r.config.spin_us = mode->spin_us;
+	r.config.busy_poll_us = mode->busy_poll_us;
+	r.config.pin_cpu = cpu >= 0;
+	r.config.cpu = cpu;
+	r.frames = frames;
+	r.latency_us = malloc(frames * sizeof(uint64_t));
+	pthread_mutex_init(&r.mutex, NULL);
+	pthread_cond_init(&r.cond, NULL);
+
+	if(r.latency_us == NULL || pthread_create(&thread, NULL, bench_receive, &r) != 0)
+	{
+		fprintf(stderr, "mlsp-bench-latency: failed to start receiver\n");
+		return 1;
+	}
+
+	pthread_mutex_lock(&r.mutex);
+	while(!r.ready)
+		pthread_cond_wait(&r.cond, &r.mutex);
+	pthread_mutex_unlock(&r.mutex);
+
+	if(r.ready == 1 && (m = mlsp_init_client(&client_config)) != NULL)
+	{
+		for(int i=0;i<frames;++i)
+		{
+			frame.timestamp = bench_realtime_us();
+			mlsp_send(m, &frame, 0);
+			nanosleep(&interval, NULL);
+		}
+		mlsp_close(m);
+	}
+
+	pthread_join(thread, NULL);
+
+	if(r.received)
+	{
+		qsort(r.latency_us, r.received, sizeof(uint64_t), bench_compare);
+		printf("%-16s %8d %8llu %8llu %8llu %8llu\n", mode->name, r.received,
+			(unsigned long long)r.latency_us[r.received / 2],
+			(unsigned long long)r.latency_us[r.received * 99 / 100],
+			(unsigned long long)r.latency_us[r.received * 999 / 1000],
+			(unsigned long long)r.latency_us[r.received - 1]);
+	}
+	else
+		printf("%-16s no frames received\n", mode->name);
+
+	free(r.latency_us);
+	pthread_mutex_destroy(&r.mutex);
+	pthread_cond_destroy(&r.cond);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const int frames = argc > 1 ? atoi(argv[1]) : 10000;
+	const int interval_us = argc > 2 ? atoi(argv[2]) : 200;
+	const int cpu = argc > 3 ? atoi(argv[3]) : -1;
+
+	const struct bench_mode modes[] =
+	{
+		{"blocking", 0, 0},
+		{"spin 50 us", 50, 0},
+		{"spin 1000 us", 1000, 0},
+		{"busy poll 50 us", 0, 50},
+	};
+
+	if(frames <= 0 || interval_us < 0 || interval_us >= 1000000)
+	{
+		fprintf(stderr, "usage: mlsp-bench-latency [frames] [interval us] [receiver cpu]\n");
+		return 1;
+	}
+
+	printf("%-16s %8s %8s %8s %8s %8s\n", "mode", "frames", "p50 us", "p99 us", "p99.9 us", "max us");
+
+	for(size_t i=0;i<sizeof(modes)/sizeof(modes[0]);++i)
+		if(bench_mode(&modes[i], BENCH_PORT + i, frames, interval_us, cpu) != 0)
+			return 1;
+
+	return 0;
+}
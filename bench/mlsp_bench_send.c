@@ -0,0 +1,133 @@
+/*
+ * MLSP Minimal Latency Streaming Protocol per packet send cost benchmark
+ *
+ * Copyright 2019-2020 (C) Bartosz Meglicki <meglickib@gmail.com>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ */
+
+/*
+ * Per packet cost of sendto with address on unconnected UDP socket
+ * versus send on connected socket (what mlsp_init_client does)
+ * and of mlsp_send on connected client for reference.
+ *
+ * Packets are MLSP sized (header and 1400 bytes of payload).
+ * Sink socket bound on the port of local destination is never read,
+ * the kernel drops packets once its buffer is full.
+ *
+ * Usage: mlsp-bench-send [packets, default 1000000] [destination ip, default 127.0.0.1]
+ */
+
+#include "../mlsp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+enum {BENCH_PORT = 9795, BENCH_PACKET_SIZE = 28 + 1400, BENCH_PAYLOAD = 1400, BENCH_ROUNDS = 5}; //packet is MLSP header and payload
+
+static double bench_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//returns ns per packet
+static double bench_socket(const struct sockaddr_in *address, int connected, int packets)
+{
+	uint8_t packet[BENCH_PACKET_SIZE] = {0};
+	const int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	double start, ns;
+
+	if(fd == -1 || (connected && connect(fd, (const struct sockaddr*)address, sizeof(*address)) == -1))
+	{
+		fprintf(stderr, "mlsp-bench-send: failed to initialize UDP socket\n");
+		exit(1);
+	}
+
+	start = bench_seconds();
+
+	for(int i=0;i<packets;++i)
+		if(connected)
+			send(fd, packet, sizeof(packet), 0);
+		else
+			sendto(fd, packet, sizeof(packet), 0, (const struct sockaddr*)address, sizeof(*address));
+
+	ns = (bench_seconds() - start) * 1e9 / packets;
+
+	close(fd);
+	return ns;
+}
+
+//returns ns per packet of library send with 64 packet frames
+static double bench_mlsp(const char *ip, int packets)
+{
+	struct mlsp_config config = {ip, BENCH_PORT};
+	const int frame_packets = 64;
+	struct mlsp_frame frame = {NULL, frame_packets * BENCH_PAYLOAD};
+	struct mlsp *m = mlsp_init_client(&config);
+	double start, ns;
+
+	if(m == NULL || (frame.data = calloc(1, frame.size)) == NULL)
+	{
+		fprintf(stderr, "mlsp-bench-send: failed to initialize client\n");
+		exit(1);
+	}
+
+	start = bench_seconds();
+
+	for(int i=0;i<packets / frame_packets;++i)
+		mlsp_send(m, &frame, 0);
+
+	ns = (bench_seconds() - start) * 1e9 / (packets / frame_packets * frame_packets);
+
+	free(frame.data);
+	mlsp_close(m);
+	return ns;
+}
+
+int main(int argc, char **argv)
+{
+	const int packets = argc > 1 ? atoi(argv[1]) : 1000000;
+	const char *ip = argc > 2 ? argv[2] : "127.0.0.1";
+	struct sockaddr_in address = {0}, sink_address = {0};
+	const int sink = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+	address.sin_family = sink_address.sin_family = AF_INET;
+	address.sin_port = sink_address.sin_port = htons(BENCH_PORT);
+	sink_address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	if(packets < 64 || !inet_pton(AF_INET, ip, &address.sin_addr))
+	{
+		fprintf(stderr, "usage: mlsp-bench-send [packets] [destination ip]\n");
+		return 1;
+	}
+
+	//local destination without listener would answer with ICMP port unreachable
+	if(sink == -1 || bind(sink, (struct sockaddr*)&sink_address, sizeof(sink_address)) == -1)
+		fprintf(stderr, "mlsp-bench-send: failed to bind sink socket, continuing without it\n");
+
+	printf("%-6s %14s %14s %14s\n", "round", "sendto ns", "send ns", "mlsp_send ns");
+
+	//alternate variants so that frequency and cache state changes affect all
+	for(int r=0;r<BENCH_ROUNDS;++r)
+	{
+		const double sendto_ns = bench_socket(&address, 0, packets);
+		const double send_ns = bench_socket(&address, 1, packets);
+		const double mlsp_ns = bench_mlsp(ip, packets);
+
+		printf("%-6d %14.0f %14.0f %14.0f\n", r, sendto_ns, send_ns, mlsp_ns);
+	}
+
+	close(sink);
+	return 0;
+}
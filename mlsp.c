@@ -9,6 +9,10 @@
  *
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE //sched_setaffinity, CPU_SET
+#endif
+
 #include "mlsp.h"
 
 #include <stdio.h> //fprintf
@@ -16,10 +20,89 @@
 #include <string.h> //memcpy
 #include <errno.h> //errno
 #include <unistd.h> //close
+#include <poll.h> //poll
+#include <time.h> //clock_gettime
 #include <netinet/in.h> //socaddr_in
 #include <arpa/inet.h> //inet_pton, etc
-
-enum {PACKET_MAX_PAYLOAD=1400, PACKET_HEADER_SIZE=8};
+#include <sys/uio.h> //iovec
+#include <sched.h> //sched_setaffinity
+#include <net/if.h> //if_nametoindex
+
+#ifdef __linux__
+#include <linux/errqueue.h> //sock_extended_err, SO_EE_ORIGIN_ZEROCOPY
+#include <linux/sockios.h> //SIOCOUTQ
+#include <sys/ioctl.h> //ioctl
+#include <sys/random.h> //getrandom
+#include <sys/epoll.h> //epoll_create1, epoll_ctl
+#define MLSP_ZEROCOPY
+#define MLSP_EPOLL
+#define MLSP_MMSG //sendmmsg, recvmmsg
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h> //io_uring_params, io_uring_sqe, io_uring_cqe
+#include <sys/syscall.h> //__NR_io_uring_setup, etc
+#include <sys/mman.h> //mmap
+#define MLSP_IO_URING
+#endif
+#if __has_include(<linux/bpf.h>)
+#include <linux/bpf.h> //bpf_attr, bpf_insn
+#include <sys/syscall.h> //__NR_bpf
+#include <sys/mman.h> //mmap
+#define MLSP_BPF
+#endif
+#if __has_include(<linux/if_xdp.h>) && defined(MLSP_BPF)
+#include <linux/if_xdp.h> //sockaddr_xdp, xdp_umem_reg, xdp_desc
+#include <linux/if_link.h> //XDP_FLAGS_SKB_MODE
+#define MLSP_AF_XDP
+#endif
+#if __has_include(<linux/if_packet.h>) && __has_include(<linux/filter.h>)
+#include <linux/if_packet.h> //tpacket_req3, tpacket_block_desc, sockaddr_ll
+#include <linux/if_ether.h> //ETH_P_IP
+#include <linux/filter.h> //sock_filter, sock_fprog
+#include <sys/mman.h> //mmap
+#define MLSP_PACKET_RING
+#endif
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h> //_mm_stream_si128, _mm256_stream_si256, _mm_sfence
+#define MLSP_X86_STREAMING_STORES
+#endif
+
+enum {PACKET_MAX_PAYLOAD=1400, PACKET_HEADER_SIZE=28};
+
+//internal wait result in addition to mlsp_retval_enum
+enum {MLSP_DEADLINE=1};
+
+//control packet types (subframe field of header with 0 subframes) and payload sizes
+enum {CONTROL_REPORT=0, CONTROL_PING=1, CONTROL_PONG=2,
+	CONTROL_REPORT_SIZE=36, CONTROL_PING_SIZE=12, CONTROL_PONG_SIZE=16};
+
+//ping/pong samples from which the one with the lowest round trip time is used
+enum {CLOCK_SAMPLES=8};
+
+//bandwidth estimator defaults (bits/s), queueing delay growth between reports signalling overuse,
+//loss (per mille) above which bitrate is decreased and below which it may increase, increase per second (%)
+enum {ESTIMATOR_START_BITRATE=1000000, ESTIMATOR_MIN_BITRATE=100000, ESTIMATOR_OVERUSE_US=2000,
+	ESTIMATOR_DECREASE_LOSS=100, ESTIMATOR_INCREASE_LOSS=20, ESTIMATOR_INCREASE_PERCENT=8};
+
+//receivers (e.g. destinations or multicast members) estimated separately, the slowest one sets target,
+//receiver that stopped reporting for REPORT_TIMEOUT_MS no longer limits it
+enum {REPORT_RECEIVERS=16, REPORT_TIMEOUT_MS=5000};
+
+//io_uring submission queue entries, provided receive buffers and their size
+enum {URING_ENTRIES=256, URING_BUFFERS=1024, URING_BUFFER_SIZE=2048};
+
+//AF_XDP UMEM frames, their size and rx ring entries (powers of 2)
+enum {XDP_FRAMES=4096, XDP_FRAME_SIZE=2048, XDP_RX_ENTRIES=2048};
+
+//TPACKET_V3 ring blocks, their size and ms after which partially filled block is handed out
+enum {RING_BLOCKS=32, RING_BLOCK_SIZE=1 << 17, RING_FRAME_SIZE=2048, RING_BLOCK_TIMEOUT_MS=1};
+
+//packets received (and forwarded) by relay with single recvmmsg
+enum {RELAY_BATCH=64};
 
 //some higher level libraries may have optimized routines
 //with reads exceeding end of buffer
@@ -35,9 +118,126 @@ enum {BUFFER_PADDING_SIZE = 32};
  * u8 subframe
  * u16 packets
  * u16 packet
+ * u64 timestamp
+ * u32 session
+ * u64 send time (sender time when frame was sent, user timestamp may be capture time)
  * u8[] payload data
+ *
+ * control packet (subframes 0) structure
+ * u16 framenumber (report: highest received)
+ * u8 subframes = 0
+ * u8 type (report, ping, pong)
+ * u16 packets = 0
+ * u16 packet = 0 (report: sequence)
+ * u64 timestamp (report: receiver time, ping: sender time, pong: echoed ping time)
+ * u32 session (of sender)
+ * u64 send time = 0
+ * u8[] payload (report: u32 received, lost, completed, dropped, jitter, u64 received bytes, i64 min transit)
+ *              (ping: i64 clock offset, u32 rtt of sender estimate, pong: u64 receive and send receiver time)
  */
 
+//payload placement routine, memcpy or streaming store variant
+typedef void *(*mlsp_copy_function)(void *dest, const void *src, size_t n);
+
+#ifdef MLSP_MMSG
+typedef struct mmsghdr mlsp_mmsghdr;
+#else
+//same layout, batched messages are sent one by one
+typedef struct
+{
+	struct msghdr msg_hdr;
+	unsigned int msg_len;
+} mlsp_mmsghdr;
+#endif
+
+//packets prepared for batched submission
+struct mlsp_batch
+{
+	uint8_t *headers; //encoded header per packet
+	struct iovec *iov; //header and payload per packet
+	mlsp_mmsghdr *msg; //message per packet and destination
+	int size; //queued packets
+	int messages; //queued messages
+	int reserved; //allocated packets
+};
+
+#ifdef MLSP_IO_URING
+
+//io_uring instance with mmaped rings
+struct mlsp_uring
+{
+	int fd;
+	unsigned sq_entries;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+	void *sq_ring, *cq_ring;
+	size_t sq_ring_size, cq_ring_size, sqes_size;
+	//receiver multishot recvmsg with provided buffer ring
+	struct io_uring_buf_ring *buf_ring;
+	uint8_t *buffers;
+	struct msghdr recv_msg; //multishot template
+	int armed; //multishot recvmsg is active
+	int buffer; //provided buffer of currently processed packet, -1 if none
+};
+
+#endif
+
+#ifdef MLSP_AF_XDP
+
+//AF_XDP socket in copy mode with XDP redirect program
+struct mlsp_xdp
+{
+	int fd; //AF_XDP socket
+	int map_fd; //XSKMAP with fd at queue index
+	int prog_fd; //XDP program redirecting MLSP packets to map
+	int link_fd; //program attachment to interface, detached on close
+	uint8_t *umem;
+	unsigned *rx_producer, *rx_consumer;
+	struct xdp_desc *rx_desc;
+	unsigned *fill_producer, *fill_consumer;
+	uint64_t *fill_addr;
+	void *rx_ring, *fill_ring;
+	size_t rx_ring_size, fill_ring_size;
+	uint64_t frame; //UMEM frame of currently processed packet
+	int holding; //frame is held by library
+};
+
+#endif
+
+#ifdef MLSP_PACKET_RING
+
+//AF_PACKET socket with TPACKET_V3 receive ring
+struct mlsp_packet_ring
+{
+	int fd;
+	uint8_t *ring;
+	unsigned block; //currently processed block
+	int in_block; //block is owned by library
+	int remaining; //packets of block not processed yet
+	const uint8_t *next; //next packet of block
+};
+
+#endif
+
+//relay receive buffers and forwarded messages
+struct mlsp_relay
+{
+	uint8_t packets[RELAY_BATCH][PACKET_HEADER_SIZE + PACKET_MAX_PAYLOAD];
+	struct iovec recv_iov[RELAY_BATCH]; //whole packet buffers
+	mlsp_mmsghdr recv_msg[RELAY_BATCH];
+	struct iovec send_iov[RELAY_BATCH]; //received part of packet buffers
+	mlsp_mmsghdr *send_msg; //message per packet and destination
+};
+
+//additional listening socket of multi-port server
+struct mlsp_port
+{
+	int fd;
+	uint32_t rxq_drops; //last socket drop counter reported by kernel (SO_RXQ_OVFL)
+};
+
 //library level packet
 struct mlsp_packet
 {
@@ -46,6 +246,9 @@ struct mlsp_packet
 	uint8_t subframe; //current subframe
 	uint16_t packets; //total packets in frame
 	uint16_t packet; //current packet
+	uint64_t timestamp; //subframe timestamp
+	uint32_t session; //random sender session identifier
+	uint64_t send_time; //sender time when frame was sent, for estimator
 	const uint8_t *data;
 	uint16_t size; //data size, not in protocol
 };
@@ -60,27 +263,200 @@ struct mlsp_collected_frame
 	int collected_packets;
 	uint8_t *received_packets; //flags received packets
 	int received_packets_size;
+	int last_packet_size; //0 until the last packet is received
+	int contiguous_packets; //packets received in order from the first one
+	uint64_t timestamp;
+};
+
+//sender estimator state of single reporting receiver
+struct mlsp_receiver
+{
+	struct sockaddr_in address; //sin_family 0 if unused
+	struct mlsp_report report; //the last report of receiver
+	uint32_t target_bitrate; //estimate of path to receiver
+	uint64_t report_ms; //time of the last report
+	uint16_t report_sequence; //sequence of the last report
 };
 
 struct mlsp
 {
 	int socket_udp;
 	struct sockaddr_in address_udp;
+	int connected; //client socket is connected to address_udp
+	struct sockaddr_in *destinations; //multiple destinations of client, NULL if single address_udp
+	int destinations_count;
+	int *paths; //connected sockets of multipath client, NULL if single socket_udp
+	int paths_count;
+	int path_next; //path of the next striped packet
+	uint32_t redundant_subframes; //subframes sent through all paths
+	struct mlsp_port *ports; //additional sockets of multi-port server, NULL if single socket_udp
+	int ports_count;
+	int port_next; //socket to read first, socket_udp is 0 and ports follow
+	int batched; //packets are queued and sent per frame (io_uring or multiple destinations)
+	int backend; //mlsp_backend_enum
+	int poll_fd; //descriptor to wait on for packets (socket or io_uring)
+	struct mlsp_batch batch; //queued packets for batched backends
+	struct mlsp_relay *relay; //forwarding buffers, NULL if not relay
+#ifdef MLSP_IO_URING
+	struct mlsp_uring uring;
+#endif
+#ifdef MLSP_AF_XDP
+	struct mlsp_xdp xdp;
+#endif
+#ifdef MLSP_PACKET_RING
+	struct mlsp_packet_ring ring;
+#endif
 	int subframes; //number of logical subframes in frame
-	uint16_t framenumber; //currently assembled frame framenumber
+	int independent_subframes; //each subframe has its own framenumber sequence
+	uint16_t framenumber[MLSP_MAX_SUBFRAMES]; //currently assembled/sent frame framenumber of sequence
+	uint8_t synchronized[MLSP_MAX_SUBFRAMES]; //framenumber of sequence is known in current session
+	uint32_t session; //sender session, 0 if receiver is not synchronized
+	uint8_t frame_subframes; //subframes of currently assembled frame (as sent)
+	int partial_frames; //deliver incomplete frames
+	int subframe_delivery; //deliver subframes independently as soon as they complete
+	int pending_size; //size of packet in data already received but not processed yet
+	mlsp_prefix_callback prefix_callback; //progressive delivery of subframe prefixes
+	void *prefix_user;
+	int timeout_ms; //receive timeout
+	int spin_us; //non-blocking receive budget before blocking, 0 if disabled
+	int deadline_ms; //incomplete frame deadline, 0 if disabled
+	uint64_t frame_start_ms[MLSP_MAX_SUBFRAMES]; //first packet of currently assembled frame of sequence, 0 if none
+	uint64_t last_packet_ms; //last received packet or mlsp_receive call
 	uint8_t data[PACKET_HEADER_SIZE + PACKET_MAX_PAYLOAD]; //single library level packet
+	const uint8_t *packet; //received packet, data or backend buffer
 	struct mlsp_collected_frame collected[MLSP_MAX_SUBFRAMES]; //frame during collection
 	uint8_t transffered_subframes[MLSP_MAX_SUBFRAMES]; //flags received/sent subframes
 	struct mlsp_frame frame[MLSP_MAX_SUBFRAMES]; //single user level packet
+	mlsp_copy_function copy; //payload placement into collected frame
+	int weights[MLSP_MAX_SUBFRAMES]; //packets per scheduling round of subframes in mlsp_send_frame
+	int zerocopy; //send with MSG_ZEROCOPY
+	int skip_frames; //send without blocking, skip the rest of frame when socket buffer is full
+	int send_buffer; //socket_udp send buffer size (with kernel overhead)
+	uint32_t skipped_frames; //frames not sent or sent partially
+	uint8_t *headers[MLSP_MAX_SUBFRAMES]; //zerocopy packet headers of subframe, kept until completion
+	int headers_size[MLSP_MAX_SUBFRAMES]; //reserved headers (packets)
+	uint32_t headers_in_flight[MLSP_MAX_SUBFRAMES]; //zerocopy_sent value after the last use of headers
+	uint32_t zerocopy_sent; //zerocopy sends issued
+	uint32_t zerocopy_completed; //zerocopy sends completed by kernel
+	uint32_t rxq_drops; //last socket drop counter reported by kernel (SO_RXQ_OVFL)
+	uint32_t unaccounted_drops; //kernel drops not attributed to sequence yet
+	uint32_t kernel_drops[MLSP_MAX_SUBFRAMES]; //kernel drops while assembling current frame of sequence
+	uint32_t duplicates[MLSP_MAX_SUBFRAMES]; //duplicate packets while assembling current frame of sequence
+	uint32_t late_packets[MLSP_MAX_SUBFRAMES]; //packets of older frames while assembling current frame of sequence
+	int filter_map_fd; //kernel filter state map
+	uint64_t *filter_state; //mmaped kernel filter state per sequence, NULL if disabled
+	int report_ms; //receiver report interval, 0 if disabled
+	uint64_t report_next_ms; //time of the next receiver report
+	uint16_t report_sequence; //sequence of the next receiver report
+	struct sockaddr_in source; //source address of the last received packet
+	struct mlsp_report stats; //receiver statistics sent in reports
+	int64_t transit_us; //arrival time minus timestamp of the last frame, for jitter
+	int transit_sampled; //min_transit_us of stats sampled since the last report
+	struct mlsp_report report; //the last report received by sender
+	int report_new; //report received since the last mlsp_get_report
+	uint32_t target_bitrate; //sender bandwidth estimate, the lowest of receivers
+	struct mlsp_receiver receivers[REPORT_RECEIVERS]; //reporting receivers
+	uint32_t min_bitrate, max_bitrate; //bandwidth estimate limits
+	int ping_ms; //sender ping interval, 0 if disabled
+	uint64_t ping_next_ms; //time of the next ping
+	struct mlsp_clock clock_samples[CLOCK_SAMPLES]; //the last ping/pong exchanges, rtt_us 0 if none
+	int clock_sample; //the oldest sample
+	struct mlsp_clock clock; //estimate (from sender for receiver), rtt_us 0 if none
+};
+
+//kernel filter state of sequence, session 0 passes all packets
+struct mlsp_filter_state
+{
+	uint32_t session;
+	uint32_t framenumber;
 };
 
 static struct mlsp *mlsp_init_common(const struct mlsp_config *config);
 static struct mlsp *mlsp_close_and_return_null(struct mlsp *m);
+static void mlsp_advance_framenumber(struct mlsp *m, uint8_t subframe);
+static void mlsp_prepare_header(struct mlsp *m, const struct mlsp_frame *frame, uint8_t subframe, struct mlsp_packet *udp);
+static int mlsp_send_packet(struct mlsp *m, const struct mlsp_frame *frame, struct mlsp_packet *udp, uint16_t packet);
+static void mlsp_encode_header(uint8_t *data, const struct mlsp_packet *udp);
+static uint16_t mlsp_packets(uint32_t data_size);
 static int mlsp_send_udp(struct mlsp *m, int data_size);
-static int mlsp_decode_header(const struct mlsp *m, int size, struct mlsp_packet *udp);
-static void mlsp_decode_payload(struct mlsp *m, const struct mlsp_packet *udp);
-static void mlsp_new_frame(struct mlsp *m, uint16_t framenumber);
+static void mlsp_destination(struct mlsp *m, struct msghdr *msg);
+static int mlsp_destinations_init(struct mlsp *m, const struct mlsp_config *config);
+static int mlsp_paths_init(struct mlsp *m, const struct mlsp_config *config);
+static int mlsp_send_paths(struct mlsp *m, const struct mlsp_packet *udp, int data_size);
+static int mlsp_send_queue_full(const struct mlsp *m, int packets);
+static int mlsp_skip_frame(struct mlsp *m, int subframe, int subframes);
+static int mlsp_sendmmsg(struct mlsp *m);
+#ifdef MLSP_MMSG
+static int mlsp_relay_forward(struct mlsp *m, int packets);
+#endif
+static int mlsp_multicast_sender(struct mlsp *m, const struct mlsp_config *config);
+static int mlsp_multicast_join(struct mlsp *m, const struct mlsp_config *config);
+static int mlsp_multicast(const struct mlsp *m);
+static int mlsp_send_zerocopy(struct mlsp *m, const struct mlsp_packet *udp);
+static int mlsp_zerocopy_reserve(struct mlsp *m, uint8_t subframe, uint16_t packets);
+static int mlsp_zerocopy_drain(struct mlsp *m, int timeout_ms);
+static int mlsp_batch_reserve(struct mlsp *m, int packets);
+static void mlsp_batch_add(struct mlsp *m, const struct mlsp_packet *udp);
+static int mlsp_batch_flush(struct mlsp *m);
+static int mlsp_recv_packet(struct mlsp *m);
+static int mlsp_backend_init(struct mlsp *m, const struct mlsp_config *config, int server);
+static int mlsp_backend_result(struct mlsp *m, int backend, int result);
+static void mlsp_backend_close(struct mlsp *m);
+#ifdef MLSP_IO_URING
+static int mlsp_uring_init(struct mlsp *m, int server);
+static void mlsp_uring_close(struct mlsp *m);
+static int mlsp_uring_send(struct mlsp *m);
+static int mlsp_uring_recv(struct mlsp *m);
+#endif
+#ifdef MLSP_AF_XDP
+static int mlsp_xdp_init(struct mlsp *m, const struct mlsp_config *config);
+static void mlsp_xdp_close(struct mlsp *m);
+static int mlsp_xdp_recv(struct mlsp *m);
+#endif
+#ifdef MLSP_PACKET_RING
+static int mlsp_ring_init(struct mlsp *m, const struct mlsp_config *config);
+static void mlsp_ring_close(struct mlsp *m);
+static int mlsp_ring_recv(struct mlsp *m);
+#endif
+static int mlsp_decode_header(struct mlsp *m, int size, struct mlsp_packet *udp);
+static void mlsp_decode_payload(struct mlsp *m, int subframes);
+static void mlsp_decode_subframe(struct mlsp *m, int subframe, int subframes);
+static int mlsp_sequence(const struct mlsp *m, int subframe);
+static int mlsp_sequences(const struct mlsp *m);
+static int mlsp_sequence_subframes(const struct mlsp *m, int sequence, int *last);
+static int mlsp_sequence_complete(const struct mlsp *m, int sequence);
+static const struct mlsp_frame *mlsp_partial_frame(struct mlsp *m, int sequence);
+static void mlsp_prefix(struct mlsp *m, const struct mlsp_packet *udp);
+static int mlsp_wait(struct mlsp *m, int *sequence);
+static const struct mlsp_frame *mlsp_expire_frame(struct mlsp *m, int sequence);
+static uint64_t mlsp_monotonic_ms(void);
+static uint64_t mlsp_realtime_us(void);
+static uint64_t mlsp_monotonic_us(void);
+static int mlsp_spin(const struct mlsp *m, struct pollfd *pfd);
+static int mlsp_poll_packets(struct mlsp *m, int fd);
+static int mlsp_low_latency(struct mlsp *m, const struct mlsp_config *config);
+static void mlsp_socket_buffer(struct mlsp *m, const struct mlsp_config *config, int fd, int option);
+static void mlsp_rxq_drops(struct mlsp *m, struct msghdr *msg, uint32_t *rxq_drops);
+static int mlsp_ports_init(struct mlsp *m, const struct mlsp_config *config);
+static int mlsp_ports_recv(struct mlsp *m, struct msghdr *msg);
+static int mlsp_framenumber_newer(uint16_t framenumber, uint16_t current);
+static const struct mlsp_frame *mlsp_partial_any(struct mlsp *m);
+static void mlsp_new_session(struct mlsp *m, uint32_t session);
+static void mlsp_new_frame(struct mlsp *m, int sequence, uint16_t framenumber);
+static void mlsp_filter_update(struct mlsp *m, int sequence);
+static int mlsp_filter_init(struct mlsp *m);
+static void mlsp_filter_close(struct mlsp *m);
 static int mlsp_new_subframe(struct mlsp_collected_frame *collected, struct mlsp_packet *udp);
+static void mlsp_frame_stats(struct mlsp *m, int sequence, const struct mlsp_packet *udp);
+static void mlsp_report(struct mlsp *m);
+static int mlsp_control_recv(struct mlsp *m);
+static void mlsp_control_process(struct mlsp *m, const uint8_t *data, int size, uint64_t arrival_us, const struct sockaddr_in *source);
+static struct mlsp_receiver *mlsp_report_receiver(struct mlsp *m, const struct sockaddr_in *source, uint64_t now_ms);
+static void mlsp_ping(struct mlsp *m);
+static void mlsp_pong(struct mlsp *m, const uint8_t *data, uint64_t arrival_us);
+static void mlsp_clock_sample(struct mlsp *m, const uint8_t *data, uint64_t arrival_us);
+static uint32_t mlsp_estimate(const struct mlsp *m, uint32_t target_bitrate, const struct mlsp_report *previous, const struct mlsp_report *report);
+static mlsp_copy_function mlsp_copy_select(int nontemporal);
 
 static struct mlsp *mlsp_init_common(const struct mlsp_config *config)
 {
@@ -99,7 +475,16 @@ static struct mlsp *mlsp_init_common(const struct mlsp_config *config)
 	}
 
 	*m = zero_mlsp; //set all members of dynamically allocated struct to 0 in a portable way
+	m->poll_fd = -1;
+	m->packet = m->data;
 	m->subframes = config->subframes > 0 ? config->subframes : 1;
+	m->independent_subframes = config->independent_subframes;
+	m->copy = mlsp_copy_select(config->nontemporal);
+	m->partial_frames = config->partial_frames;
+	//subframes with own sequences are always delivered independently
+	m->subframe_delivery = config->subframe_delivery || config->independent_subframes;
+	m->prefix_callback = config->prefix_callback;
+	m->prefix_user = config->prefix_user;
 
 	//create a UDP socket
 	if ( (m->socket_udp = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP) ) == -1)
@@ -131,12 +516,120 @@ struct mlsp *mlsp_init_client(const struct mlsp_config *config)
 	if(m == NULL)
 		return NULL;
 
-	if(config->ip == NULL || config->ip[0] == '\0')
+	if(config->destinations_count > 0 && mlsp_destinations_init(m, config) != MLSP_OK)
+		return mlsp_close_and_return_null(m);
+
+	if(m->destinations != NULL)
+		m->address_udp = m->destinations[0];
+
+	//single destination is sent the usual (connected) way
+	if(m->destinations_count == 1)
+	{
+		free(m->destinations);
+		m->destinations = NULL;
+		m->destinations_count = 0;
+	}
+
+	if((config->ip == NULL || config->ip[0] == '\0') && config->destinations_count <= 0)
 	{
 		fprintf(stderr, "mlsp: missing address argument for client\n");
 		return mlsp_close_and_return_null(m);
 	}
 
+	for(int s=0;s<MLSP_MAX_SUBFRAMES;++s)
+		m->weights[s] = config->weights[s] > 0 ? config->weights[s] : 1;
+
+	m->min_bitrate = config->min_bitrate ? config->min_bitrate : ESTIMATOR_MIN_BITRATE;
+	m->max_bitrate = config->max_bitrate ? config->max_bitrate : UINT32_MAX;
+	m->target_bitrate = config->start_bitrate ? config->start_bitrate : ESTIMATOR_START_BITRATE;
+
+	m->ping_ms = config->ping_ms > 0 ? config->ping_ms : 0;
+
+	const int timestamps = 1;
+
+	//pong arrival time is taken by kernel, not when user reads it
+	if(m->ping_ms && setsockopt(m->socket_udp, SOL_SOCKET, SO_TIMESTAMP, &timestamps, sizeof(timestamps)) == -1)
+		fprintf(stderr, "mlsp: failed to enable receive timestamps\n");
+
+	if(m->max_bitrate < m->min_bitrate)
+		m->max_bitrate = m->min_bitrate;
+	if(m->target_bitrate < m->min_bitrate || m->target_bitrate > m->max_bitrate)
+		m->target_bitrate = m->target_bitrate < m->min_bitrate ? m->min_bitrate : m->max_bitrate;
+
+	mlsp_socket_buffer(m, config, m->socket_udp, SO_SNDBUF);
+
+	if(mlsp_multicast(m) && mlsp_multicast_sender(m, config) != MLSP_OK)
+		return mlsp_close_and_return_null(m);
+
+	//route and address are resolved once instead of per packet
+	//socket connected to multicast group would discard unicast reports and pongs of receivers
+	if(m->destinations == NULL && !mlsp_multicast(m))
+	{
+		if(connect(m->socket_udp, (struct sockaddr*)&m->address_udp, sizeof(m->address_udp)) == 0)
+			m->connected = 1;
+		else
+			fprintf(stderr, "mlsp: failed to connect socket, falling back to sendto\n");
+	}
+
+	if(config->zerocopy)
+	{
+#ifdef MLSP_ZEROCOPY
+		int one = 1;
+
+		if(setsockopt(m->socket_udp, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0)
+			m->zerocopy = 1;
+		else
+#endif
+			fprintf(stderr, "mlsp: zerocopy not supported, falling back to copy\n");
+	}
+
+	if(mlsp_backend_init(m, config, 0) != MLSP_OK)
+		return mlsp_close_and_return_null(m);
+
+	m->batched = m->backend != MLSP_BACKEND_SOCKET || m->destinations != NULL;
+
+	if(m->zerocopy && m->batched)
+	{
+		fprintf(stderr, "mlsp: zerocopy is supported only with socket backend and single destination, ignoring\n");
+		m->zerocopy = 0;
+	}
+
+	if(config->skip_frames && m->backend != MLSP_BACKEND_SOCKET)
+		fprintf(stderr, "mlsp: frame skipping is supported only with socket backend, ignoring\n");
+	else if(config->skip_frames)
+	{
+		socklen_t size = sizeof(m->send_buffer);
+
+		m->skip_frames = 1;
+
+		if(getsockopt(m->socket_udp, SOL_SOCKET, SO_SNDBUF, &m->send_buffer, &size) == -1)
+			m->send_buffer = 0;
+	}
+
+	if(config->paths_count > 0 && m->batched)
+	{
+		fprintf(stderr, "mlsp: paths are supported only with socket backend and single destination\n");
+		return mlsp_close_and_return_null(m);
+	}
+
+	if(config->paths_count > 0 && mlsp_paths_init(m, config) != MLSP_OK)
+		return mlsp_close_and_return_null(m);
+
+	if(m->zerocopy && m->paths)
+	{
+		fprintf(stderr, "mlsp: zerocopy is not supported with paths, ignoring\n");
+		m->zerocopy = 0;
+	}
+
+	//random session lets receiver detect sender restart on the first packet
+#ifdef __linux__
+	if(getrandom(&m->session, sizeof(m->session), GRND_NONBLOCK) != sizeof(m->session))
+#endif
+		m->session = (uint32_t)mlsp_realtime_us() ^ ((uint32_t)getpid() << 16);
+
+	if(m->session == 0)
+		m->session = 1;
+
 	return m;
 }
 
@@ -151,6 +644,12 @@ struct mlsp *mlsp_init_server(const struct mlsp_config *config)
 	if(config->ip == NULL || config->ip[0] == '\0')
 		m->address_udp.sin_addr.s_addr = htonl(INADDR_ANY);
 
+	m->timeout_ms = config->timeout_ms;
+	m->spin_us = config->spin_us > 0 ? config->spin_us : 0;
+	m->deadline_ms = config->deadline_ms > 0 ? config->deadline_ms : 0;
+	m->last_packet_ms = mlsp_monotonic_ms();
+	m->report_ms = config->report_ms > 0 ? config->report_ms : 0;
+
 	//set timeout if necessary
 	if(config->timeout_ms > 0)
 	{	//TODO - simplify
@@ -164,12 +663,102 @@ struct mlsp *mlsp_init_server(const struct mlsp_config *config)
 		}
 	}
 
+	mlsp_socket_buffer(m, config, m->socket_udp, SO_RCVBUF);
+
+#ifdef SO_RXQ_OVFL
+	const int one = 1;
+
+	//drop counter in control message of each packet, attributed to frames
+	if(setsockopt(m->socket_udp, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) == -1)
+		fprintf(stderr, "mlsp: failed to enable kernel drop reporting\n");
+#endif
+
+	if(mlsp_multicast(m))
+	{	//multiple consumers of the group on the same host
+		const int reuse = 1;
+
+		if(setsockopt(m->socket_udp, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == -1)
+			fprintf(stderr, "mlsp: failed to set address reuse for multicast\n");
+	}
+
 	if( bind(m->socket_udp, (struct sockaddr*)&m->address_udp, sizeof(m->address_udp) ) == -1 )
 	{
 		fprintf(stderr, "mlsp: failed to bind socket to address\n");
 		return mlsp_close_and_return_null(m);
 	}
 
+	if(mlsp_multicast(m) && mlsp_multicast_join(m, config) != MLSP_OK)
+		return mlsp_close_and_return_null(m);
+
+	if(mlsp_backend_init(m, config, 1) != MLSP_OK)
+		return mlsp_close_and_return_null(m);
+
+	if(config->ports_count > 0 && mlsp_ports_init(m, config) != MLSP_OK)
+		return mlsp_close_and_return_null(m);
+
+	if(m->report_ms && m->backend != MLSP_BACKEND_SOCKET && m->backend != MLSP_BACKEND_IO_URING)
+	{
+		fprintf(stderr, "mlsp: reports are supported only with socket backends, ignoring\n");
+		m->report_ms = 0;
+	}
+
+	if(mlsp_low_latency(m, config) != MLSP_OK)
+		return mlsp_close_and_return_null(m);
+
+	if(config->kernel_filter && m->backend != MLSP_BACKEND_SOCKET && m->backend != MLSP_BACKEND_IO_URING)
+		fprintf(stderr, "mlsp: kernel filter applies to socket backends only, ignoring\n");
+	else if(config->kernel_filter && mlsp_filter_init(m) != MLSP_OK)
+		return mlsp_close_and_return_null(m);
+
+	return m;
+}
+
+struct mlsp *mlsp_init_relay(const struct mlsp_config *config)
+{
+	struct mlsp *m;
+	struct mlsp_relay *r;
+
+#ifndef MLSP_MMSG
+	fprintf(stderr, "mlsp: relay not supported on this platform\n");
+	return NULL;
+#endif
+
+	if(config->backend != MLSP_BACKEND_SOCKET)
+	{
+		fprintf(stderr, "mlsp: relay supports only socket backend\n");
+		return NULL;
+	}
+
+	if(config->destinations_count <= 0)
+	{
+		fprintf(stderr, "mlsp: missing destinations argument for relay\n");
+		return NULL;
+	}
+
+	if( (m = mlsp_init_server(config)) == NULL)
+		return NULL;
+
+	if(mlsp_destinations_init(m, config) != MLSP_OK)
+		return mlsp_close_and_return_null(m);
+
+	if( (m->relay = r = malloc(sizeof(struct mlsp_relay))) == NULL ||
+		(r->send_msg = malloc(RELAY_BATCH * m->destinations_count * sizeof(mlsp_mmsghdr))) == NULL)
+	{
+		fprintf(stderr, "mlsp: not enough memory for relay\n");
+		return mlsp_close_and_return_null(m);
+	}
+
+	memset(r->recv_msg, 0, sizeof(r->recv_msg));
+	memset(r->send_msg, 0, RELAY_BATCH * m->destinations_count * sizeof(mlsp_mmsghdr));
+
+	for(int i=0;i<RELAY_BATCH;++i)
+	{
+		r->recv_iov[i].iov_base = r->send_iov[i].iov_base = r->packets[i];
+		r->recv_iov[i].iov_len = sizeof(r->packets[i]);
+		r->recv_msg[i].msg_hdr.msg_iov = &r->recv_iov[i];
+		r->recv_msg[i].msg_hdr.msg_iovlen = 1;
+	}
+
 	return m;
 }
 
@@ -178,13 +767,38 @@ void mlsp_close(struct mlsp *m)
 	if(m == NULL)
 		return;
 
+	mlsp_backend_close(m);
+	mlsp_filter_close(m);
+
 	if(close(m->socket_udp) == -1)
 		fprintf(stderr, "mlsp: error while closing socket\n");
 
+	free(m->batch.headers);
+	free(m->batch.iov);
+	free(m->batch.msg);
+	free(m->destinations);
+
+	for(int p=0;p<m->paths_count;++p)
+		if(m->paths[p] != -1 && close(m->paths[p]) == -1)
+			fprintf(stderr, "mlsp: error while closing path socket\n");
+	free(m->paths);
+
+	for(int p=0;p<m->ports_count;++p)
+		if(m->ports[p].fd != -1 && close(m->ports[p].fd) == -1)
+			fprintf(stderr, "mlsp: error while closing port socket\n");
+	if(m->ports && m->poll_fd != -1 && close(m->poll_fd) == -1)
+		fprintf(stderr, "mlsp: error while closing epoll descriptor\n");
+	free(m->ports);
+
+	if(m->relay)
+		free(m->relay->send_msg);
+	free(m->relay);
+
 	for(int i=0;i<m->subframes;++i)
 	{
 		free(m->collected[i].data);
 		free(m->collected[i].received_packets);
+		free(m->headers[i]);
 	}
 	free(m);
 }
@@ -197,189 +811,2606 @@ static struct mlsp *mlsp_close_and_return_null(struct mlsp *m)
 
 int mlsp_send(struct mlsp *m, const struct mlsp_frame *frame, uint8_t subframe)
 {
-	const uint8_t *data = frame->data;
-	const uint32_t data_size = frame->size;
+	struct mlsp_packet udp;
+	int result;
 
-	//if size is not divisible by MAX_PAYLOAD we have additional packet with the rest
-	const uint16_t packets = data_size / PACKET_MAX_PAYLOAD + ((data_size % PACKET_MAX_PAYLOAD) != 0);
-	//last packet is smaller unless it is exactly MAX_PAYLOAD size
-	const uint16_t last_packet_size = ((data_size % PACKET_MAX_PAYLOAD) !=0 ) ? data_size % PACKET_MAX_PAYLOAD : PACKET_MAX_PAYLOAD;
+	if(m->ping_ms)
+		mlsp_ping(m);
 
-	if(m->transffered_subframes[subframe])
-	{
-		memset(m->transffered_subframes, 0, MLSP_MAX_SUBFRAMES);
-		++m->framenumber;
-	}
+	//failed call doesn't consume framenumber
+	if(m->zerocopy && mlsp_zerocopy_reserve(m, subframe, mlsp_packets(frame->size)) != MLSP_OK)
+		return MLSP_ERROR;
 
-	for(uint16_t p=0;p<packets;++p)
-	{
-		//encode header
-		memcpy(m->data, &m->framenumber, sizeof(m->framenumber));
-		m->data[2] = m->subframes;
-		m->data[3] = subframe;
-		memcpy(m->data+4, &packets, sizeof(packets));
-		memcpy(m->data+6, &p, sizeof(p));
+	mlsp_advance_framenumber(m, subframe);
+	mlsp_prepare_header(m, frame, subframe, &udp);
 
-		//encode payload, last packet may be smaller
-		uint16_t size = (p < packets-1) ? PACKET_MAX_PAYLOAD : last_packet_size;
-		memcpy(m->data+8, data + p * PACKET_MAX_PAYLOAD, size);
+	if(mlsp_send_queue_full(m, udp.packets))
+		return mlsp_skip_frame(m, subframe, 1);
 
-		if( mlsp_send_udp(m, size + PACKET_HEADER_SIZE) != MLSP_OK )
-			return MLSP_ERROR;
-	}
+	if(mlsp_batch_reserve(m, udp.packets) != MLSP_OK)
+		return MLSP_ERROR;
+
+	for(uint16_t p=0;p<udp.packets;++p)
+		if( (result = mlsp_send_packet(m, frame, &udp, p)) != MLSP_OK )
+			return result == MLSP_SKIPPED ? mlsp_skip_frame(m, subframe, 1) : result;
+
+	if( (result = mlsp_batch_flush(m)) != MLSP_OK)
+		return result == MLSP_SKIPPED ? mlsp_skip_frame(m, subframe, 1) : result;
 
 	m->transffered_subframes[subframe] = 1;
 
 	return MLSP_OK;
 }
 
-static int mlsp_send_udp(struct mlsp *m, int data_size)
+int mlsp_send_frame(struct mlsp *m, const struct mlsp_frame *frame, int subframes)
 {
-	int result;
-	int written=0;
+	struct mlsp_packet udp[MLSP_MAX_SUBFRAMES];
+	uint16_t sent[MLSP_MAX_SUBFRAMES] = {0};
+	int remaining = 0, result;
 
-	while(written<data_size)
+	if(subframes < 1 || subframes > m->subframes)
 	{
-		if ((result = sendto(m->socket_udp, m->data+written, data_size-written, 0, (struct sockaddr*)&m->address_udp, sizeof(m->address_udp))) == -1)
-		{
-			fprintf(stderr, "mlsp: failed to send udp data\n");
-			return MLSP_ERROR;
-		}
-		written += result;
+		fprintf(stderr, "mlsp: frame subframes outside of configured range\n");
+		return MLSP_ERROR;
 	}
-	return MLSP_OK;
-}
 
-const struct mlsp_frame *mlsp_receive(struct mlsp *m, int *error)
-{
-	int recv_len;
-	struct mlsp_packet udp;
+	if(m->ping_ms)
+		mlsp_ping(m);
 
-	while(1)
+	//failed call doesn't consume framenumbers
+	for(int s=0;s<subframes;++s)
+		if(m->zerocopy && mlsp_zerocopy_reserve(m, s, mlsp_packets(frame[s].size)) != MLSP_OK)
+			return MLSP_ERROR;
+
+	for(int s=0;s<subframes;++s)
+		mlsp_advance_framenumber(m, s);
+
+	for(int s=0;s<subframes;++s)
 	{
-		if((recv_len = recvfrom(m->socket_udp, m->data, PACKET_MAX_PAYLOAD+PACKET_HEADER_SIZE, 0, NULL, NULL)) == -1)
-		{
-			if(errno==EAGAIN || errno==EWOULDBLOCK || errno==EINPROGRESS)
-			{  //prepare for new streaming sequence on timeout
-				m->framenumber = 0;
-				mlsp_new_frame(m, 0);
-				*error = MLSP_TIMEOUT;
-			}
-			else
-				*error = MLSP_ERROR;
+		mlsp_prepare_header(m, &frame[s], s, &udp[s]);
+		remaining += udp[s].packets;
+	}
 
-			return NULL;
-		}
+	if(mlsp_send_queue_full(m, remaining))
+		return mlsp_skip_frame(m, 0, subframes);
 
-		if(mlsp_decode_header(m, recv_len, &udp) != MLSP_OK)
-			continue;
+	if(mlsp_batch_reserve(m, remaining) != MLSP_OK)
+		return MLSP_ERROR;
 
-		if(m->framenumber < udp.framenumber)
-			mlsp_new_frame(m, udp.framenumber);
+	//weighted round robin, each round subframe sends up to weight packets
+	while(remaining)
+		for(int s=0;s<subframes;++s)
+			for(int w=0; w < m->weights[s] && sent[s] < udp[s].packets; ++w, ++sent[s], --remaining)
+				if( (result = mlsp_send_packet(m, &frame[s], &udp[s], sent[s])) != MLSP_OK )
+					return result == MLSP_SKIPPED ? mlsp_skip_frame(m, 0, subframes) : result;
 
-		struct mlsp_collected_frame *collected = &m->collected[udp.subframe];
+	if( (result = mlsp_batch_flush(m)) != MLSP_OK)
+		return result == MLSP_SKIPPED ? mlsp_skip_frame(m, 0, subframes) : result;
 
-		if( collected->data == NULL || collected->packets != udp.packets)
-			if( ( *error = mlsp_new_subframe(collected, &udp) ) != MLSP_OK)
-				return NULL;
+	memset(m->transffered_subframes, 1, subframes);
 
-		if(collected->received_packets[udp.packet])
-		{
-			fprintf(stderr, "mlsp: ignoring packet (duplicate)\n");
-			continue;
-		}
+	return MLSP_OK;
+}
 
-		collected->received_packets[udp.packet] = 1;
-		memcpy(collected->data + udp.packet*PACKET_MAX_PAYLOAD, udp.data, udp.size);
+//starts new frame (of subframe sequence) if subframe was already sent in current one
+static void mlsp_advance_framenumber(struct mlsp *m, uint8_t subframe)
+{
+	const int sequence = mlsp_sequence(m, subframe);
+	int first, last;
 
-		++collected->collected_packets;
-		collected->actual_size += udp.size;
+	if(!m->transffered_subframes[subframe])
+		return;
 
-		if(collected->collected_packets == udp.packets)
-		{
-			m->transffered_subframes[udp.subframe] = 1;
+	first = mlsp_sequence_subframes(m, sequence, &last);
+	memset(m->transffered_subframes + first, 0, last - first);
+	++m->framenumber[sequence];
+}
 
-			int received = 0;
+static void mlsp_prepare_header(struct mlsp *m, const struct mlsp_frame *frame, uint8_t subframe, struct mlsp_packet *udp)
+{
+	udp->framenumber = m->framenumber[mlsp_sequence(m, subframe)];
+	udp->subframes = m->subframes;
+	udp->subframe = subframe;
+	udp->packets = mlsp_packets(frame->size);
+	udp->send_time = mlsp_realtime_us();
+	udp->timestamp = frame->timestamp ? frame->timestamp : udp->send_time;
+	udp->session = m->session;
+}
 
-			for(int i=0;i<udp.subframes;++i)
-				received += m->transffered_subframes[i];
+static int mlsp_send_packet(struct mlsp *m, const struct mlsp_frame *frame, struct mlsp_packet *udp, uint16_t packet)
+{
+	//last packet is smaller unless it is exactly MAX_PAYLOAD size
+	const uint16_t last_packet_size = ((frame->size % PACKET_MAX_PAYLOAD) !=0 ) ? frame->size % PACKET_MAX_PAYLOAD : PACKET_MAX_PAYLOAD;
 
-			if(received != udp.subframes)
-				continue;
+	udp->packet = packet;
+	udp->size = (packet < udp->packets-1) ? PACKET_MAX_PAYLOAD : last_packet_size;
+	udp->data = frame->data + packet * PACKET_MAX_PAYLOAD;
 
-			mlsp_decode_payload(m, &udp);
+	if(m->zerocopy)
+		return mlsp_send_zerocopy(m, udp);
 
-			return m->frame;
-		}
+	if(m->batched)
+	{	//sent later in single batch
+		mlsp_batch_add(m, udp);
+		return MLSP_OK;
 	}
+
+	mlsp_encode_header(m->data, udp);
+	memcpy(m->data+PACKET_HEADER_SIZE, udp->data, udp->size);
+
+	if(m->paths)
+		return mlsp_send_paths(m, udp, udp->size + PACKET_HEADER_SIZE);
+
+	return mlsp_send_udp(m, udp->size + PACKET_HEADER_SIZE);
 }
 
-static int mlsp_decode_header(const struct mlsp *m, int size, struct mlsp_packet *udp)
+//frame wouldn't fit in what is left of socket send buffer
+static int mlsp_send_queue_full(const struct mlsp *m, int packets)
 {
-	const uint8_t *data = m->data;
+#ifdef SIOCOUTQ
+	const int destinations = m->destinations ? m->destinations_count : 1;
+	int queued;
+
+	//path sockets have their own queues, those are checked on send
+	if(!m->skip_frames || m->paths || m->send_buffer <= 0)
+		return 0;
+
+	//frame larger than the whole buffer is sent into idle socket, EAGAIN skips the rest
+	if(ioctl(m->socket_udp, SIOCOUTQ, &queued) == -1 || queued <= 0)
+		return 0;
+
+	//queued bytes include kernel bookkeeping (skb truesize), roughly as much as packet itself
+	return queued + (int64_t)packets * destinations * 2 * (PACKET_HEADER_SIZE + PACKET_MAX_PAYLOAD) > m->send_buffer;
+#else
+	return 0;
+#endif
+}
 
-	if(size < PACKET_HEADER_SIZE)
-	{
-		fprintf(stderr, "mlsp: packet size smaller than MLSP header\n");
-		return MLSP_ERROR;
-	}
+//rest of frame is abandoned, the next one gets new framenumber
+static int mlsp_skip_frame(struct mlsp *m, int subframe, int subframes)
+{
+	m->batch.size = m->batch.messages = 0;
+	memset(m->transffered_subframes + subframe, 1, subframes);
+	++m->skipped_frames;
 
-	memcpy(&udp->framenumber, data, sizeof(udp->framenumber));
-	udp->subframes = data[2];
-	udp->subframe = data[3];
-	memcpy(&udp->packets, data+4, sizeof(udp->packets));
-	memcpy(&udp->packet, data+6, sizeof(udp->packet));
+	return MLSP_SKIPPED;
+}
 
-	udp->size = size - PACKET_HEADER_SIZE;
+uint32_t mlsp_get_skipped_frames(const struct mlsp *m)
+{
+	return m->skipped_frames;
+}
 
-	if(udp->size > PACKET_MAX_PAYLOAD)
-	{
-		fprintf(stderr, "mlsp: packet paylod size would exceed max paylod\n");
-		return MLSP_ERROR;
-	}
+//redundant subframe packets go through all paths, other packets through the next path
+static int mlsp_send_paths(struct mlsp *m, const struct mlsp_packet *udp, int data_size)
+{
+	const int redundant = (m->redundant_subframes >> udp->subframe) & 1;
+	const int first = m->path_next;
+	int paths_down = 0;
 
-	if(udp->subframe >= udp->subframes)
-	{
-		fprintf(stderr, "mlsp: decoded packet would exceed frame subframes\n");
-		return MLSP_ERROR;
-	}
+	if(!redundant)
+		m->path_next = (m->path_next + 1) % m->paths_count;
 
-	if(udp->packet >= udp->packets)
+	for(int i=0;i<m->paths_count;++i)
 	{
-		fprintf(stderr, "mlsp: decoded packet would exceed frame packets\n");
-		return MLSP_ERROR;
-	}
+		const int p = (first + i) % m->paths_count;
+		int down = 0;
 
-	if(udp->framenumber < m->framenumber)
-	{
-		fprintf(stderr, "mlsp: ignoring packet with older framenumber\n");
-		return MLSP_ERROR;
+		while(send(m->paths[p], m->data, data_size, m->skip_frames ? MSG_DONTWAIT : 0) == -1)
+		{	//ICMP port unreachable for earlier packet, receiver may not be running yet
+			if(errno == ECONNREFUSED)
+				continue;
+			//path may be temporarily down (e.g. no link), the others still deliver
+			if(errno == ENETUNREACH || errno == ENETDOWN || errno == EHOSTUNREACH)
+			{
+				down = 1;
+				break;
+			}
+			//congested path of redundant packet is skipped like down one
+			if(m->skip_frames && (errno == EAGAIN || errno == EWOULDBLOCK))
+			{
+				if(redundant)
+					break;
+				return MLSP_SKIPPED;
+			}
+
+			fprintf(stderr, "mlsp: failed to send udp data through path %d\n", p);
+			return MLSP_ERROR;
+		}
+
+		paths_down += down;
+
+		//striped packet is retried on the next path only if this one is down
+		if(!redundant && !down)
+			return MLSP_OK;
 	}
 
-	if(udp->subframes > m->subframes || udp->subframe >= m->subframes)
+	if(paths_down == m->paths_count)
 	{
-		fprintf(stderr, "mlsp: ignoring packet with incorrect subframe(s)\n");
+		fprintf(stderr, "mlsp: failed to send udp data, all paths are down\n");
 		return MLSP_ERROR;
 	}
 
-	udp->data = data + PACKET_HEADER_SIZE;
 	return MLSP_OK;
 }
 
-static void mlsp_decode_payload(struct mlsp *m, const struct mlsp_packet *udp)
+static void mlsp_encode_header(uint8_t *data, const struct mlsp_packet *udp)
 {
-	for(int i=0;i<m->subframes;++i)
-	{	//note - we accept lower number of subframes from sender then initialized for receiver
-		m->frame[i].size = i < udp->subframes ? m->collected[i].actual_size : 0;
-		m->frame[i].data = i < udp->subframes ? m->collected[i].data : NULL;
-	}
+	memcpy(data, &udp->framenumber, sizeof(udp->framenumber));
+	data[2] = udp->subframes;
+	data[3] = udp->subframe;
+	memcpy(data+4, &udp->packets, sizeof(udp->packets));
+	memcpy(data+6, &udp->packet, sizeof(udp->packet));
+	memcpy(data+8, &udp->timestamp, sizeof(udp->timestamp));
+	memcpy(data+16, &udp->session, sizeof(udp->session));
+	memcpy(data+20, &udp->send_time, sizeof(udp->send_time));
 }
 
-static void mlsp_new_frame(struct mlsp *m, uint16_t framenumber)
+static uint16_t mlsp_packets(uint32_t data_size)
+{	//if size is not divisible by MAX_PAYLOAD we have additional packet with the rest
+	return data_size / PACKET_MAX_PAYLOAD + ((data_size % PACKET_MAX_PAYLOAD) != 0);
+}
+
+static int mlsp_send_udp(struct mlsp *m, int data_size)
 {
-	if(m->framenumber)
-		for(int s=0;s<m->subframes;++s)
-			if(!m->transffered_subframes[s] && m->collected[s].packets)
+	int result;
+	int written=0;
+	const int flags = m->skip_frames ? MSG_DONTWAIT : 0;
+
+	while(written<data_size)
+	{
+		if(m->connected)
+			result = send(m->socket_udp, m->data+written, data_size-written, flags);
+		else
+			result = sendto(m->socket_udp, m->data+written, data_size-written, flags, (struct sockaddr*)&m->address_udp, sizeof(m->address_udp));
+
+		if(result == -1)
+		{	//ICMP port unreachable for earlier packet, receiver may not be running yet
+			if(errno == ECONNREFUSED)
+				continue;
+			//socket buffer is full, network is slower than the stream
+			if(m->skip_frames && (errno == EAGAIN || errno == EWOULDBLOCK))
+				return MLSP_SKIPPED;
+
+			fprintf(stderr, "mlsp: failed to send udp data\n");
+			return MLSP_ERROR;
+		}
+		written += result;
+	}
+	return MLSP_OK;
+}
+
+static int mlsp_multicast(const struct mlsp *m)
+{
+	return IN_MULTICAST(ntohl(m->address_udp.sin_addr.s_addr));
+}
+
+//TTL, loopback and outgoing interface of multicast group stream
+static int mlsp_multicast_sender(struct mlsp *m, const struct mlsp_config *config)
+{
+	const int ttl = config->multicast_ttl, loop = !config->multicast_no_loop;
+#ifdef __linux__
+	struct ip_mreqn mreq = {0};
+#endif
+
+	if(ttl > 0 && setsockopt(m->socket_udp, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to set multicast TTL\n");
+		return MLSP_ERROR;
+	}
+
+	if(setsockopt(m->socket_udp, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to set multicast loopback\n");
+		return MLSP_ERROR;
+	}
+
+	if(config->interface == NULL)
+		return MLSP_OK;
+
+#ifdef __linux__
+	if( (mreq.imr_ifindex = if_nametoindex(config->interface)) == 0 ||
+		setsockopt(m->socket_udp, IPPROTO_IP, IP_MULTICAST_IF, &mreq, sizeof(mreq)) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to set multicast interface %s\n", config->interface);
+		return MLSP_ERROR;
+	}
+
+	return MLSP_OK;
+#else
+	fprintf(stderr, "mlsp: multicast sender interface not supported on this platform\n");
+	return MLSP_ERROR;
+#endif
+}
+
+//joins group of server address on interface (or default), source-specific if source is set
+static int mlsp_multicast_join(struct mlsp *m, const struct mlsp_config *config)
+{
+	const unsigned ifindex = config->interface ? if_nametoindex(config->interface) : 0;
+	struct sockaddr_in group = m->address_udp, source = {0};
+
+	if(config->interface && ifindex == 0)
+	{
+		fprintf(stderr, "mlsp: unknown interface %s\n", config->interface);
+		return MLSP_ERROR;
+	}
+
+	group.sin_port = 0;
+
+	if(config->source == NULL || config->source[0] == '\0')
+	{
+		struct group_req req = {0};
+
+		req.gr_interface = ifindex;
+		memcpy(&req.gr_group, &group, sizeof(group));
+
+		if(setsockopt(m->socket_udp, IPPROTO_IP, MCAST_JOIN_GROUP, &req, sizeof(req)) == -1)
+		{
+			fprintf(stderr, "mlsp: failed to join multicast group\n");
+			return MLSP_ERROR;
+		}
+
+		return MLSP_OK;
+	}
+
+	struct group_source_req req = {0};
+
+	source.sin_family = AF_INET;
+
+	if(!inet_pton(AF_INET, config->source, &source.sin_addr))
+	{
+		fprintf(stderr, "mlsp: failed to initialize multicast source address\n");
+		return MLSP_ERROR;
+	}
+
+	req.gsr_interface = ifindex;
+	memcpy(&req.gsr_group, &group, sizeof(group));
+	memcpy(&req.gsr_source, &source, sizeof(source));
+
+	if(setsockopt(m->socket_udp, IPPROTO_IP, MCAST_JOIN_SOURCE_GROUP, &req, sizeof(req)) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to join source-specific multicast group\n");
+		return MLSP_ERROR;
+	}
+
+	return MLSP_OK;
+}
+
+//parses "ip" or "ip:port" destinations
+static int mlsp_destinations_init(struct mlsp *m, const struct mlsp_config *config)
+{
+	const int count = config->destinations_count;
+
+	if( (m->destinations = malloc(count * sizeof(struct sockaddr_in))) == NULL)
+	{
+		fprintf(stderr, "mlsp: not enough memory for destinations\n");
+		return MLSP_ERROR;
+	}
+
+	for(int d=0;d<count;++d)
+	{
+		char ip[INET_ADDRSTRLEN] = {0};
+		const char *destination = config->destinations[d];
+		const char *colon = destination ? strchr(destination, ':') : NULL;
+		const size_t ip_size = colon ? (size_t)(colon - destination) : (destination ? strlen(destination) : 0);
+		const int port = colon ? atoi(colon + 1) : config->port;
+
+		m->destinations[d] = m->address_udp;
+		m->destinations[d].sin_port = htons(port);
+
+		if(ip_size > 0 && ip_size < sizeof(ip))
+			memcpy(ip, destination, ip_size);
+
+		if(port <= 0 || port > 65535 || !inet_pton(AF_INET, ip, &m->destinations[d].sin_addr))
+		{
+			fprintf(stderr, "mlsp: failed to initialize destination address %s\n", destination ? destination : "(null)");
+			return MLSP_ERROR;
+		}
+	}
+
+	m->destinations_count = count;
+
+	return MLSP_OK;
+}
+
+//socket per path bound to local address or interface and connected to address_udp
+static int mlsp_paths_init(struct mlsp *m, const struct mlsp_config *config)
+{
+	if( (m->paths = malloc(config->paths_count * sizeof(int))) == NULL)
+	{
+		fprintf(stderr, "mlsp: not enough memory for paths\n");
+		return MLSP_ERROR;
+	}
+
+	for(int p=0;p<config->paths_count;++p)
+		m->paths[p] = -1;
+
+	m->paths_count = config->paths_count;
+	m->redundant_subframes = config->redundant_subframes;
+
+	for(int p=0;p<m->paths_count;++p)
+	{
+		const char *path = config->paths[p] ? config->paths[p] : "";
+		struct sockaddr_in local = {0};
+
+		local.sin_family = AF_INET;
+
+		if( (m->paths[p] = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP)) == -1)
+		{
+			fprintf(stderr, "mlsp: failed to initialize UDP socket for path %s\n", path);
+			return MLSP_ERROR;
+		}
+
+		//local address or otherwise interface name
+		if(inet_pton(AF_INET, path, &local.sin_addr))
+		{
+			if(bind(m->paths[p], (struct sockaddr*)&local, sizeof(local)) == -1)
+			{
+				fprintf(stderr, "mlsp: failed to bind path socket to %s\n", path);
+				return MLSP_ERROR;
+			}
+		}
+		else
+		{
+#ifdef SO_BINDTODEVICE
+			if(setsockopt(m->paths[p], SOL_SOCKET, SO_BINDTODEVICE, path, strlen(path)) == -1)
+			{
+				fprintf(stderr, "mlsp: failed to bind path socket to interface %s\n", path);
+				return MLSP_ERROR;
+			}
+#else
+			fprintf(stderr, "mlsp: paths by interface name not supported on this platform, use local address\n");
+			return MLSP_ERROR;
+#endif
+		}
+
+		mlsp_socket_buffer(m, config, m->paths[p], SO_SNDBUF);
+
+		if(connect(m->paths[p], (struct sockaddr*)&m->address_udp, sizeof(m->address_udp)) == -1)
+		{
+			fprintf(stderr, "mlsp: failed to connect path socket %s\n", path);
+			return MLSP_ERROR;
+		}
+	}
+
+	return MLSP_OK;
+}
+
+//connected socket sends without address
+static void mlsp_destination(struct mlsp *m, struct msghdr *msg)
+{
+	msg->msg_name = m->connected ? NULL : &m->address_udp;
+	msg->msg_namelen = m->connected ? 0 : sizeof(m->address_udp);
+}
+
+#ifdef MLSP_ZEROCOPY
+
+//kernel pins both header and payload pages until completion
+static int mlsp_send_zerocopy(struct mlsp *m, const struct mlsp_packet *udp)
+{
+	uint8_t *header = m->headers[udp->subframe] + udp->packet * PACKET_HEADER_SIZE;
+	struct iovec iov[2] = { {header, PACKET_HEADER_SIZE}, {(void*)udp->data, udp->size} };
+	struct msghdr msg = {0};
+
+	mlsp_destination(m, &msg);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	mlsp_encode_header(header, udp);
+
+	while(sendmsg(m->socket_udp, &msg, MSG_ZEROCOPY | (m->skip_frames ? MSG_DONTWAIT : 0)) == -1)
+	{	//ENOBUFS when too many sends are pending (optmem limit)
+		if(errno == ECONNREFUSED) //reported for earlier packet
+			continue;
+
+		if(m->skip_frames && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return MLSP_SKIPPED;
+
+		if(errno != ENOBUFS || mlsp_zerocopy_drain(m, -1) != MLSP_OK)
+		{
+			fprintf(stderr, "mlsp: failed to send udp data\n");
+			return MLSP_ERROR;
+		}
+	}
+
+	m->headers_in_flight[udp->subframe] = ++m->zerocopy_sent;
+
+	return MLSP_OK;
+}
+
+//makes sure headers of subframe are large enough and no longer in flight
+static int mlsp_zerocopy_reserve(struct mlsp *m, uint8_t subframe, uint16_t packets)
+{
+	while((int32_t)(m->zerocopy_completed - m->headers_in_flight[subframe]) < 0)
+		if(mlsp_zerocopy_drain(m, -1) != MLSP_OK)
+			return MLSP_ERROR;
+
+	if(m->headers_size[subframe] >= packets)
+		return MLSP_OK;
+
+	free(m->headers[subframe]);
+
+	if( (m->headers[subframe] = malloc(packets * PACKET_HEADER_SIZE)) == NULL)
+	{
+		m->headers_size[subframe] = 0;
+		fprintf(stderr, "mlsp: not enough memory for zerocopy headers\n");
+		return MLSP_ERROR;
+	}
+
+	m->headers_size[subframe] = packets;
+
+	return MLSP_OK;
+}
+
+//reads completions from socket error queue, waits up to timeout_ms for the first one
+static int mlsp_zerocopy_drain(struct mlsp *m, int timeout_ms)
+{
+	struct pollfd pfd = {m->socket_udp, 0, 0}; //POLLERR is always reported
+	uint8_t control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+	int result, notifications = 0;
+
+	if( (result = poll(&pfd, 1, timeout_ms)) == 0)
+		return MLSP_TIMEOUT;
+
+	if(result == -1)
+	{	//nothing was read, caller polls again with the remaining time
+		if(errno == EINTR)
+			return MLSP_OK;
+
+		fprintf(stderr, "mlsp: failed to wait for zerocopy completion\n");
+		return MLSP_ERROR;
+	}
+
+	while(1)
+	{
+		struct msghdr msg = {0};
+		struct cmsghdr *cmsg;
+
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if(recvmsg(m->socket_udp, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+
+			fprintf(stderr, "mlsp: failed to read zerocopy completion\n");
+			return MLSP_ERROR;
+		}
+
+		++notifications;
+
+		for(cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			const struct sock_extended_err *serr = (const struct sock_extended_err*)CMSG_DATA(cmsg);
+
+			if(cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR)
+				continue;
+			if(serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+
+			//notification covers range of sends [ee_info, ee_data]
+			m->zerocopy_completed += serr->ee_data - serr->ee_info + 1;
+		}
+	}
+
+	//POLLERR with empty error queue is pending socket error (e.g. ICMP port unreachable), poll would wake on it forever
+	if(notifications == 0 && (pfd.revents & POLLERR))
+	{
+		int error = 0;
+		socklen_t error_size = sizeof(error);
+
+		if(getsockopt(m->socket_udp, SOL_SOCKET, SO_ERROR, &error, &error_size) == -1 || (error != 0 && error != ECONNREFUSED))
+		{
+			fprintf(stderr, "mlsp: socket error while waiting for zerocopy completion\n");
+			return MLSP_ERROR;
+		}
+	}
+
+	return MLSP_OK;
+}
+
+#else
+
+static int mlsp_send_zerocopy(struct mlsp *m, const struct mlsp_packet *udp)
+{
+	return MLSP_ERROR;
+}
+
+static int mlsp_zerocopy_reserve(struct mlsp *m, uint8_t subframe, uint16_t packets)
+{
+	return MLSP_ERROR;
+}
+
+static int mlsp_zerocopy_drain(struct mlsp *m, int timeout_ms)
+{
+	return MLSP_OK;
+}
+
+#endif
+
+int mlsp_zerocopy_wait(struct mlsp *m, int timeout_ms)
+{
+	const uint64_t deadline = mlsp_monotonic_ms() + (timeout_ms > 0 ? timeout_ms : 0);
+
+	while(m->zerocopy_completed != m->zerocopy_sent)
+	{
+		const uint64_t now = mlsp_monotonic_ms();
+		const int wait = timeout_ms < 0 ? -1 : (deadline > now ? (int)(deadline - now) : 0);
+		int result;
+
+		if( (result = mlsp_zerocopy_drain(m, wait)) != MLSP_OK)
+			return result;
+	}
+
+	return MLSP_OK;
+}
+
+//returns packet size (packet in m->packet) or -1 and errno (EAGAIN on timeout)
+static int mlsp_recv_packet(struct mlsp *m)
+{
+#ifdef MLSP_IO_URING
+	if(m->backend == MLSP_BACKEND_IO_URING)
+		return mlsp_uring_recv(m);
+#endif
+#ifdef MLSP_AF_XDP
+	if(m->backend == MLSP_BACKEND_AF_XDP)
+		return mlsp_xdp_recv(m);
+#endif
+#ifdef MLSP_PACKET_RING
+	if(m->backend == MLSP_BACKEND_PACKET_RING)
+		return mlsp_ring_recv(m);
+#endif
+	uint8_t control[CMSG_SPACE(sizeof(uint32_t))];
+	struct iovec iov = {m->data, PACKET_MAX_PAYLOAD+PACKET_HEADER_SIZE};
+	struct msghdr msg = {0};
+	int result = -1;
+
+	m->packet = m->data;
+	msg.msg_name = &m->source;
+	msg.msg_namelen = sizeof(m->source);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if(m->ports)
+	{
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		return mlsp_ports_recv(m, &msg);
+	}
+
+	if(m->spin_us)
+	{
+		const uint64_t end = mlsp_monotonic_us() + m->spin_us;
+
+		do
+		{
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+			msg.msg_namelen = sizeof(m->source);
+
+			if( (result = recvmsg(m->socket_udp, &msg, MSG_DONTWAIT)) != -1 || errno != EAGAIN)
+				break;
+		}
+		while(mlsp_monotonic_us() < end);
+	}
+
+	if(result == -1 && (!m->spin_us || errno == EAGAIN))
+	{
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		msg.msg_namelen = sizeof(m->source);
+		result = recvmsg(m->socket_udp, &msg, 0);
+	}
+
+	if(result != -1)
+		mlsp_rxq_drops(m, &msg, &m->rxq_drops);
+
+	return result;
+}
+
+//reads the first available packet of all sockets, starting after the last one read
+static int mlsp_ports_recv(struct mlsp *m, struct msghdr *msg)
+{
+	const int sockets = m->ports_count + 1;
+	const size_t controllen = msg->msg_controllen;
+
+	while(1)
+	{
+		for(int i=0;i<sockets;++i)
+		{
+			const int index = (m->port_next + i) % sockets;
+			const int fd = index ? m->ports[index-1].fd : m->socket_udp;
+			uint32_t *rxq_drops = index ? &m->ports[index-1].rxq_drops : &m->rxq_drops;
+			int result;
+
+			msg->msg_controllen = controllen;
+			msg->msg_namelen = sizeof(m->source);
+
+			if( (result = recvmsg(fd, msg, MSG_DONTWAIT)) != -1)
+			{
+				m->port_next = (index + 1) % sockets;
+				mlsp_rxq_drops(m, msg, rxq_drops);
+				return result;
+			}
+
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				return -1;
+		}
+
+		//epoll descriptor is readable when any of the sockets is
+		if(mlsp_poll_packets(m, m->poll_fd) == -1)
+			return -1;
+	}
+}
+
+//sockets on additional ports and epoll descriptor to wait on all of them
+static int mlsp_ports_init(struct mlsp *m, const struct mlsp_config *config)
+{
+#ifdef MLSP_EPOLL
+	struct epoll_event event = {0};
+
+	if(m->backend != MLSP_BACKEND_SOCKET)
+	{
+		fprintf(stderr, "mlsp: multiple ports are supported only with socket backend\n");
+		return MLSP_ERROR;
+	}
+
+	if( (m->ports = malloc(config->ports_count * sizeof(struct mlsp_port))) == NULL)
+	{
+		fprintf(stderr, "mlsp: not enough memory for ports\n");
+		return MLSP_ERROR;
+	}
+
+	for(int p=0;p<config->ports_count;++p)
+		m->ports[p].fd = -1, m->ports[p].rxq_drops = 0;
+
+	m->ports_count = config->ports_count;
+
+	if( (m->poll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to create epoll descriptor\n");
+		return MLSP_ERROR;
+	}
+
+	event.events = EPOLLIN;
+
+	if(epoll_ctl(m->poll_fd, EPOLL_CTL_ADD, m->socket_udp, &event) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to add socket to epoll\n");
+		return MLSP_ERROR;
+	}
+
+	for(int p=0;p<m->ports_count;++p)
+	{
+		struct sockaddr_in address = m->address_udp;
+
+		address.sin_port = htons(config->ports[p]);
+
+		if( (m->ports[p].fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP)) == -1)
+		{
+			fprintf(stderr, "mlsp: failed to initialize UDP socket for port %d\n", config->ports[p]);
+			return MLSP_ERROR;
+		}
+
+		mlsp_socket_buffer(m, config, m->ports[p].fd, SO_RCVBUF);
+
+#ifdef SO_RXQ_OVFL
+		const int one = 1;
+
+		if(setsockopt(m->ports[p].fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) == -1)
+			fprintf(stderr, "mlsp: failed to enable kernel drop reporting\n");
+#endif
+
+		if(bind(m->ports[p].fd, (struct sockaddr*)&address, sizeof(address)) == -1)
+		{
+			fprintf(stderr, "mlsp: failed to bind socket to port %d\n", config->ports[p]);
+			return MLSP_ERROR;
+		}
+
+		if(epoll_ctl(m->poll_fd, EPOLL_CTL_ADD, m->ports[p].fd, &event) == -1)
+		{
+			fprintf(stderr, "mlsp: failed to add socket to epoll\n");
+			return MLSP_ERROR;
+		}
+	}
+
+	return MLSP_OK;
+#else
+	fprintf(stderr, "mlsp: multiple ports not supported on this platform\n");
+	return MLSP_ERROR;
+#endif
+}
+
+//accumulates kernel drops since the last packet
+static void mlsp_rxq_drops(struct mlsp *m, struct msghdr *msg, uint32_t *rxq_drops)
+{
+#ifdef SO_RXQ_OVFL
+	//the counter is reported only after the first drop
+	for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
+		if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+		{
+			uint32_t drops;
+
+			memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+			m->unaccounted_drops += drops - *rxq_drops;
+			*rxq_drops = drops;
+		}
+#endif
+}
+
+//sizes socket buffer for burst of frames, forced above system limit if privileged
+static void mlsp_socket_buffer(struct mlsp *m, const struct mlsp_config *config, int fd, int option)
+{
+	if(config->max_frame_size == 0)
+		return;
+
+	//two frames or 100 ms of stream, kernel doubles the value for bookkeeping overhead
+	const uint64_t frames = config->frame_rate / 10 > 2 ? config->frame_rate / 10 : 2;
+	const uint64_t packets = frames * mlsp_packets(config->max_frame_size) * m->subframes;
+	const uint64_t requested = packets * (PACKET_HEADER_SIZE + PACKET_MAX_PAYLOAD);
+	const int size = requested < INT32_MAX / 2 ? (int)requested : INT32_MAX / 2;
+	int actual = 0;
+	socklen_t actual_size = sizeof(actual);
+
+#ifdef SO_RCVBUFFORCE
+	const int force_option = option == SO_RCVBUF ? SO_RCVBUFFORCE : SO_SNDBUFFORCE;
+
+	if(setsockopt(fd, SOL_SOCKET, force_option, &size, sizeof(size)) == 0)
+		return;
+#endif
+
+	if(setsockopt(fd, SOL_SOCKET, option, &size, sizeof(size)) == -1 ||
+		getsockopt(fd, SOL_SOCKET, option, &actual, &actual_size) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to set socket buffer size\n");
+		return;
+	}
+
+	if(actual / 2 < size)
+		fprintf(stderr, "mlsp: socket buffer limited to %d (requested %d), raise net.core.%s\n",
+			actual / 2, size, option == SO_RCVBUF ? "rmem_max" : "wmem_max");
+}
+
+//polls without blocking up to spin budget, returns 1 if packets are ready
+static int mlsp_spin(const struct mlsp *m, struct pollfd *pfd)
+{
+	const uint64_t end = mlsp_monotonic_us() + m->spin_us;
+
+	do
+		if(poll(pfd, 1, 0) > 0)
+			return 1;
+	while(mlsp_monotonic_us() < end);
+
+	return 0;
+}
+
+//waits for packets on backend descriptor, returns -1 and errno (EAGAIN on timeout) or 0
+static int mlsp_poll_packets(struct mlsp *m, int fd)
+{
+	struct pollfd pfd = {fd, POLLIN, 0};
+	int result;
+
+	if(m->spin_us && mlsp_spin(m, &pfd))
+		return 0;
+
+	if( (result = poll(&pfd, 1, m->timeout_ms > 0 ? m->timeout_ms : -1)) == 0)
+		errno = EAGAIN;
+
+	return result == 0 || (result == -1 && errno != EINTR) ? -1 : 0;
+}
+
+//kernel busy polling and CPU pinning, failures are not fatal except invalid CPU
+static int mlsp_low_latency(struct mlsp *m, const struct mlsp_config *config)
+{
+	if(config->busy_poll_us > 0)
+	{
+#ifdef SO_BUSY_POLL
+		const int one = 1;
+
+		if(setsockopt(m->socket_udp, SOL_SOCKET, SO_BUSY_POLL, &config->busy_poll_us, sizeof(config->busy_poll_us)) == -1)
+			fprintf(stderr, "mlsp: failed to set busy polling (needs CAP_NET_ADMIN above net.core.busy_read)\n");
+#ifdef SO_PREFER_BUSY_POLL
+		if(setsockopt(m->socket_udp, SOL_SOCKET, SO_PREFER_BUSY_POLL, &one, sizeof(one)) == -1)
+			fprintf(stderr, "mlsp: failed to prefer busy polling\n");
+#endif
+#else
+		fprintf(stderr, "mlsp: busy polling not supported on this platform\n");
+#endif
+	}
+
+	if(config->pin_cpu)
+	{
+#ifdef __linux__
+		cpu_set_t set;
+
+		if(config->cpu < 0 || config->cpu >= CPU_SETSIZE)
+		{
+			fprintf(stderr, "mlsp: CPU %d to pin thread to out of range\n", config->cpu);
+			return MLSP_ERROR;
+		}
+
+		CPU_ZERO(&set);
+		CPU_SET(config->cpu, &set);
+
+		//affects only the calling thread, receive from the same one
+		if(sched_setaffinity(0, sizeof(set), &set) == -1)
+		{
+			fprintf(stderr, "mlsp: failed to pin thread to CPU %d\n", config->cpu);
+			return MLSP_ERROR;
+		}
+#else
+		fprintf(stderr, "mlsp: CPU pinning not supported on this platform\n");
+#endif
+	}
+
+	return MLSP_OK;
+}
+
+//makes room for packets of the frame in batch
+static int mlsp_batch_reserve(struct mlsp *m, int packets)
+{
+	struct mlsp_batch *b = &m->batch;
+
+	const int destinations = m->destinations ? m->destinations_count : 1;
+
+	b->size = b->messages = 0;
+
+	if(!m->batched || b->reserved >= packets)
+		return MLSP_OK;
+
+	free(b->headers);
+	free(b->iov);
+	free(b->msg);
+
+	b->headers = malloc(packets * PACKET_HEADER_SIZE);
+	b->iov = malloc(packets * 2 * sizeof(struct iovec));
+	b->msg = malloc(packets * destinations * sizeof(mlsp_mmsghdr));
+
+	if(b->headers == NULL || b->iov == NULL || b->msg == NULL)
+	{
+		b->reserved = 0;
+		fprintf(stderr, "mlsp: not enough memory for packet batch\n");
+		return MLSP_ERROR;
+	}
+
+	b->reserved = packets;
+	return MLSP_OK;
+}
+
+//queues packet for all destinations, header is encoded once
+//payload is referenced (not copied) until flush
+static void mlsp_batch_add(struct mlsp *m, const struct mlsp_packet *udp)
+{
+	struct mlsp_batch *b = &m->batch;
+	uint8_t *header = b->headers + b->size * PACKET_HEADER_SIZE;
+	struct iovec *iov = b->iov + 2 * b->size;
+	const int destinations = m->destinations ? m->destinations_count : 1;
+
+	mlsp_encode_header(header, udp);
+
+	iov[0].iov_base = header;
+	iov[0].iov_len = PACKET_HEADER_SIZE;
+	iov[1].iov_base = (void*)udp->data;
+	iov[1].iov_len = udp->size;
+
+	for(int d=0;d<destinations;++d)
+	{
+		struct msghdr *msg = &b->msg[b->messages++].msg_hdr;
+
+		memset(msg, 0, sizeof(*msg));
+		mlsp_destination(m, msg);
+
+		if(m->destinations)
+			msg->msg_name = &m->destinations[d];
+
+		msg->msg_iov = iov;
+		msg->msg_iovlen = 2;
+	}
+
+	++b->size;
+}
+
+static int mlsp_batch_flush(struct mlsp *m)
+{
+#ifdef MLSP_IO_URING
+	if(m->backend == MLSP_BACKEND_IO_URING)
+		return mlsp_uring_send(m);
+#endif
+	if(m->batched)
+		return mlsp_sendmmsg(m);
+
+	return MLSP_OK;
+}
+
+//sends queued messages with as few syscalls as kernel allows
+static int mlsp_sendmmsg(struct mlsp *m)
+{
+	struct mlsp_batch *b = &m->batch;
+	int sent = 0, result;
+
+	while(sent < b->messages)
+	{
+#ifdef MLSP_MMSG
+		result = sendmmsg(m->socket_udp, b->msg + sent, b->messages - sent, m->skip_frames ? MSG_DONTWAIT : 0);
+#else
+		result = sendmsg(m->socket_udp, &b->msg[sent].msg_hdr, m->skip_frames ? MSG_DONTWAIT : 0) == -1 ? -1 : 1;
+#endif
+		if(result == -1)
+		{
+			if(errno == EINTR)
+				continue;
+
+			if(m->skip_frames && (errno == EAGAIN || errno == EWOULDBLOCK))
+			{
+				b->size = b->messages = 0;
+				return MLSP_SKIPPED;
+			}
+
+			fprintf(stderr, "mlsp: failed to send udp data\n");
+			return MLSP_ERROR;
+		}
+
+		sent += result;
+	}
+
+	b->size = b->messages = 0;
+
+	return MLSP_OK;
+}
+
+#ifdef MLSP_MMSG
+
+int mlsp_relay(struct mlsp *m)
+{
+	struct mlsp_relay *r = m->relay;
+	struct mlsp_packet udp;
+	int received, forwarded = 0;
+
+	if(r == NULL)
+	{
+		fprintf(stderr, "mlsp: relay called on handle not created with mlsp_init_relay\n");
+		return MLSP_ERROR;
+	}
+
+	//block for the first packet, take whatever else is already queued
+	while( (received = recvmmsg(m->socket_udp, r->recv_msg, RELAY_BATCH, MSG_WAITFORONE, NULL)) == -1)
+	{
+		if(errno == EINTR)
+			continue;
+
+		//restarted sender is recognized by session, timeout keeps state
+		if(errno == EAGAIN || errno == EWOULDBLOCK)
+			return MLSP_TIMEOUT;
+
+		fprintf(stderr, "mlsp: failed to receive udp data\n");
+		return MLSP_ERROR;
+	}
+
+	for(int i=0;i<received;++i)
+	{
+		const int size = r->recv_msg[i].msg_len;
+
+		m->packet = r->packets[i];
+
+		//reports and pings are end to end, relay doesn't know where to return them
+		if(size >= PACKET_HEADER_SIZE && m->packet[2] == 0)
+			continue;
+
+		if(mlsp_decode_header(m, size, &udp) != MLSP_OK)
+			continue;
+
+		if(udp.session != m->session)
+			mlsp_new_session(m, udp.session);
+
+		const int sequence = mlsp_sequence(m, udp.subframe);
+
+		//track the newest frame only to drop stale packets, nothing is collected
+		if(!m->synchronized[sequence] || mlsp_framenumber_newer(udp.framenumber, m->framenumber[sequence]))
+			mlsp_new_frame(m, sequence, udp.framenumber);
+
+		r->send_iov[forwarded].iov_base = r->packets[i];
+		r->send_iov[forwarded++].iov_len = size;
+	}
+
+	if(mlsp_relay_forward(m, forwarded) != MLSP_OK)
+		return MLSP_ERROR;
+
+	return forwarded;
+}
+
+//sends packets of send_iov to all destinations
+static int mlsp_relay_forward(struct mlsp *m, int packets)
+{
+	struct mlsp_relay *r = m->relay;
+	int messages = 0, sent = 0, result;
+
+	for(int p=0;p<packets;++p)
+		for(int d=0;d<m->destinations_count;++d)
+		{
+			struct msghdr *msg = &r->send_msg[messages++].msg_hdr;
+
+			msg->msg_name = &m->destinations[d];
+			msg->msg_namelen = sizeof(m->destinations[d]);
+			msg->msg_iov = &r->send_iov[p];
+			msg->msg_iovlen = 1;
+		}
+
+	while(sent < messages)
+	{
+		if( (result = sendmmsg(m->socket_udp, r->send_msg + sent, messages - sent, 0)) == -1)
+		{	//downstream without listener, keep forwarding to the others
+			if(errno == EINTR || errno == ECONNREFUSED)
+				continue;
+
+			fprintf(stderr, "mlsp: failed to forward udp data\n");
+			return MLSP_ERROR;
+		}
+
+		sent += result;
+	}
+
+	return MLSP_OK;
+}
+
+#else
+
+int mlsp_relay(struct mlsp *m)
+{
+	fprintf(stderr, "mlsp: relay not supported on this platform\n");
+	return MLSP_ERROR;
+}
+
+#endif
+
+//backend stays socket until the configured one is initialized, mlsp_close never sees half-built backend
+static int mlsp_backend_init(struct mlsp *m, const struct mlsp_config *config, int server)
+{
+	m->backend = MLSP_BACKEND_SOCKET;
+	m->poll_fd = m->socket_udp;
+
+	if(config->backend == MLSP_BACKEND_SOCKET)
+		return MLSP_OK;
+#ifdef MLSP_IO_URING
+	if(config->backend == MLSP_BACKEND_IO_URING)
+		return mlsp_backend_result(m, config->backend, mlsp_uring_init(m, server));
+#endif
+#ifdef MLSP_AF_XDP
+	if(config->backend == MLSP_BACKEND_AF_XDP && server)
+		return mlsp_backend_result(m, config->backend, mlsp_xdp_init(m, config));
+#endif
+#ifdef MLSP_PACKET_RING
+	if(config->backend == MLSP_BACKEND_PACKET_RING && server)
+		return mlsp_backend_result(m, config->backend, mlsp_ring_init(m, config));
+#endif
+	fprintf(stderr, "mlsp: backend not supported on this platform or side\n");
+	return MLSP_ERROR;
+}
+
+//tears down partially initialized backend on failure and falls back to socket state
+static int mlsp_backend_result(struct mlsp *m, int backend, int result)
+{
+	m->backend = backend;
+
+	if(result == MLSP_OK)
+		return MLSP_OK;
+
+	mlsp_backend_close(m);
+	m->backend = MLSP_BACKEND_SOCKET;
+	m->poll_fd = m->socket_udp;
+
+	return MLSP_ERROR;
+}
+
+static void mlsp_backend_close(struct mlsp *m)
+{
+#ifdef MLSP_IO_URING
+	if(m->backend == MLSP_BACKEND_IO_URING)
+		mlsp_uring_close(m);
+#endif
+#ifdef MLSP_AF_XDP
+	if(m->backend == MLSP_BACKEND_AF_XDP)
+		mlsp_xdp_close(m);
+#endif
+#ifdef MLSP_PACKET_RING
+	if(m->backend == MLSP_BACKEND_PACKET_RING)
+		mlsp_ring_close(m);
+#endif
+}
+
+#ifdef MLSP_IO_URING
+
+static int mlsp_uring_setup(struct mlsp_uring *u, unsigned entries, unsigned cq_entries)
+{
+	struct io_uring_params p = {0};
+
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = cq_entries;
+
+	if( (u->fd = syscall(__NR_io_uring_setup, entries, &p)) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to setup io_uring\n");
+		return MLSP_ERROR;
+	}
+
+	u->sq_entries = p.sq_entries;
+	u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	u->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+	u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+	u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+
+	if(u->sq_ring == MAP_FAILED || u->cq_ring == MAP_FAILED || u->sqes == MAP_FAILED)
+	{
+		fprintf(stderr, "mlsp: failed to map io_uring rings\n");
+		return MLSP_ERROR;
+	}
+
+	u->sq_head = (unsigned*)((uint8_t*)u->sq_ring + p.sq_off.head);
+	u->sq_tail = (unsigned*)((uint8_t*)u->sq_ring + p.sq_off.tail);
+	u->sq_mask = (unsigned*)((uint8_t*)u->sq_ring + p.sq_off.ring_mask);
+	u->sq_array = (unsigned*)((uint8_t*)u->sq_ring + p.sq_off.array);
+	u->cq_head = (unsigned*)((uint8_t*)u->cq_ring + p.cq_off.head);
+	u->cq_tail = (unsigned*)((uint8_t*)u->cq_ring + p.cq_off.tail);
+	u->cq_mask = (unsigned*)((uint8_t*)u->cq_ring + p.cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe*)((uint8_t*)u->cq_ring + p.cq_off.cqes);
+
+	return MLSP_OK;
+}
+
+//next free submission entry, caller fills it and calls mlsp_uring_advance
+static struct io_uring_sqe *mlsp_uring_sqe(struct mlsp_uring *u)
+{
+	const unsigned tail = *u->sq_tail;
+	const unsigned index = tail & *u->sq_mask;
+
+	if(tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries)
+		return NULL;
+
+	u->sq_array[index] = index;
+	memset(&u->sqes[index], 0, sizeof(struct io_uring_sqe));
+
+	return &u->sqes[index];
+}
+
+static void mlsp_uring_advance(struct mlsp_uring *u)
+{
+	__atomic_store_n(u->sq_tail, *u->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+static int mlsp_uring_enter(struct mlsp_uring *u, unsigned submit, unsigned wait)
+{
+	int result;
+
+	while( (result = syscall(__NR_io_uring_enter, u->fd, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0)) == -1 && errno == EINTR)
+		;
+
+	return result;
+}
+
+//oldest completion or NULL, caller consumes it with mlsp_uring_cqe_seen
+static struct io_uring_cqe *mlsp_uring_cqe(struct mlsp_uring *u)
+{
+	const unsigned head = *u->cq_head;
+
+	if(head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	return &u->cqes[head & *u->cq_mask];
+}
+
+static void mlsp_uring_cqe_seen(struct mlsp_uring *u)
+{
+	__atomic_store_n(u->cq_head, *u->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+//submits all queued packets of the frame, sendmsg per packet, one syscall per ring size
+static int mlsp_uring_send(struct mlsp *m)
+{
+	struct mlsp_uring *u = &m->uring;
+	struct mlsp_batch *b = &m->batch;
+	int error = 0;
+
+	for(int first = 0; first < b->messages; first += u->sq_entries)
+	{
+		const int count = b->messages - first < (int)u->sq_entries ? b->messages - first : (int)u->sq_entries;
+		int submitted = 0, completed = 0;
+
+		for(int i=0;i<count;++i)
+		{
+			struct io_uring_sqe *sqe = mlsp_uring_sqe(u);
+
+			sqe->opcode = IORING_OP_SENDMSG;
+			sqe->fd = m->socket_udp;
+			sqe->addr = (uint64_t)(uintptr_t)&b->msg[first + i].msg_hdr;
+			sqe->len = 1;
+			mlsp_uring_advance(u);
+		}
+
+		//wait for all, payload is referenced only until completion
+		while(completed < count)
+		{
+			struct io_uring_cqe *cqe;
+
+			if(submitted < count)
+			{	//kernel may take fewer (e.g. completion queue full), the rest stays queued for the next enter
+				const int result = mlsp_uring_enter(u, count - submitted, count - submitted);
+
+				if(result == -1 && errno != EBUSY && errno != EAGAIN)
+				{
+					fprintf(stderr, "mlsp: failed to submit io_uring sends\n");
+					return MLSP_ERROR;
+				}
+
+				submitted += result > 0 ? result : 0;
+			}
+			else if(mlsp_uring_enter(u, 0, 1) == -1)
+				return MLSP_ERROR;
+
+			while(completed < submitted && (cqe = mlsp_uring_cqe(u)) != NULL)
+			{	//refused is reported for earlier packet, receiver may not be running yet
+				error |= cqe->res < 0 && cqe->res != -ECONNREFUSED;
+				mlsp_uring_cqe_seen(u);
+				++completed;
+			}
+		}
+	}
+
+	b->size = b->messages = 0;
+
+	if(error)
+	{
+		fprintf(stderr, "mlsp: failed to send udp data\n");
+		return MLSP_ERROR;
+	}
+
+	return MLSP_OK;
+}
+
+//returns provided buffer to the kernel
+static void mlsp_uring_recycle(struct mlsp_uring *u, int buffer)
+{
+	const unsigned short tail = u->buf_ring->tail;
+	struct io_uring_buf *buf = &u->buf_ring->bufs[tail & (URING_BUFFERS - 1)];
+
+	buf->addr = (uint64_t)(uintptr_t)(u->buffers + buffer * URING_BUFFER_SIZE);
+	buf->len = URING_BUFFER_SIZE;
+	buf->bid = buffer;
+
+	__atomic_store_n(&u->buf_ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static int mlsp_uring_arm(struct mlsp *m)
+{
+	struct mlsp_uring *u = &m->uring;
+	struct io_uring_sqe *sqe = mlsp_uring_sqe(u);
+
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = m->socket_udp;
+	sqe->addr = (uint64_t)(uintptr_t)&u->recv_msg;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = 0;
+	mlsp_uring_advance(u);
+
+	if(mlsp_uring_enter(u, 1, 0) != 1)
+	{
+		fprintf(stderr, "mlsp: failed to submit io_uring multishot receive\n");
+		return MLSP_ERROR;
+	}
+
+	u->armed = 1;
+	return MLSP_OK;
+}
+
+static int mlsp_uring_server(struct mlsp *m)
+{
+	struct mlsp_uring *u = &m->uring;
+	struct io_uring_buf_reg reg = {0};
+	const size_t ring_size = URING_BUFFERS * sizeof(struct io_uring_buf);
+
+	u->buf_ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	u->buffers = mmap(NULL, URING_BUFFERS * URING_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if(u->buf_ring == MAP_FAILED || u->buffers == MAP_FAILED)
+	{
+		fprintf(stderr, "mlsp: not enough memory for io_uring buffers\n");
+		return MLSP_ERROR;
+	}
+
+#ifdef SO_RXQ_OVFL
+	u->recv_msg.msg_controllen = CMSG_SPACE(sizeof(uint32_t));
+#endif
+	u->recv_msg.msg_namelen = sizeof(m->source);
+
+	reg.ring_addr = (uint64_t)(uintptr_t)u->buf_ring;
+	reg.ring_entries = URING_BUFFERS;
+	reg.bgid = 0;
+
+	if(syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to register io_uring buffer ring\n");
+		return MLSP_ERROR;
+	}
+
+	u->buf_ring->tail = 0;
+
+	for(int i=0;i<URING_BUFFERS;++i)
+		mlsp_uring_recycle(u, i);
+
+	return mlsp_uring_arm(m);
+}
+
+//next packet from multishot receive, points m->packet to provided buffer
+static int mlsp_uring_recv(struct mlsp *m)
+{
+	struct mlsp_uring *u = &m->uring;
+	struct io_uring_cqe *cqe;
+
+	//previous packet was processed
+	if(u->buffer != -1)
+		mlsp_uring_recycle(u, u->buffer), u->buffer = -1;
+
+	while(1)
+	{
+		if(!u->armed && mlsp_uring_arm(m) != MLSP_OK)
+			return -1;
+
+		if( (cqe = mlsp_uring_cqe(u)) == NULL)
+		{
+			if(mlsp_poll_packets(m, u->fd) == -1)
+				return -1;
+			continue;
+		}
+
+		const int res = cqe->res;
+		const unsigned flags = cqe->flags;
+
+		mlsp_uring_cqe_seen(u);
+
+		//multishot terminates e.g. when out of buffers
+		if(!(flags & IORING_CQE_F_MORE))
+			u->armed = 0;
+
+		if(res < 0)
+		{
+			if(res == -ENOBUFS)
+				continue;
+
+			errno = -res;
+			return -1;
+		}
+
+		if(!(flags & IORING_CQE_F_BUFFER))
+			continue;
+
+		u->buffer = flags >> IORING_CQE_BUFFER_SHIFT;
+
+		const uint8_t *buffer = u->buffers + u->buffer * URING_BUFFER_SIZE;
+		const struct io_uring_recvmsg_out *out = (const struct io_uring_recvmsg_out*)buffer;
+
+		//payload follows header, name (source address) and control
+		struct msghdr msg = {0};
+
+		if(out->namelen >= sizeof(m->source))
+			memcpy(&m->source, buffer + sizeof(struct io_uring_recvmsg_out), sizeof(m->source));
+
+		msg.msg_control = (uint8_t*)buffer + sizeof(struct io_uring_recvmsg_out) + u->recv_msg.msg_namelen;
+		msg.msg_controllen = out->controllen;
+		mlsp_rxq_drops(m, &msg, &m->rxq_drops);
+
+		m->packet = buffer + sizeof(struct io_uring_recvmsg_out) + u->recv_msg.msg_namelen + u->recv_msg.msg_controllen;
+
+		return out->payloadlen;
+	}
+}
+
+static int mlsp_uring_init(struct mlsp *m, int server)
+{
+	m->uring.fd = -1;
+	m->uring.buffer = -1;
+
+	if(mlsp_uring_setup(&m->uring, URING_ENTRIES, server ? 4 * URING_BUFFERS : 2 * URING_ENTRIES) != MLSP_OK)
+		return MLSP_ERROR;
+
+	m->poll_fd = m->uring.fd;
+
+	return server ? mlsp_uring_server(m) : MLSP_OK;
+}
+
+static void mlsp_uring_close(struct mlsp *m)
+{
+	struct mlsp_uring *u = &m->uring;
+
+	if(u->sq_ring && u->sq_ring != MAP_FAILED)
+		munmap(u->sq_ring, u->sq_ring_size);
+	if(u->cq_ring && u->cq_ring != MAP_FAILED)
+		munmap(u->cq_ring, u->cq_ring_size);
+	if(u->sqes && u->sqes != MAP_FAILED)
+		munmap(u->sqes, u->sqes_size);
+	if(u->buf_ring && u->buf_ring != MAP_FAILED)
+		munmap(u->buf_ring, URING_BUFFERS * sizeof(struct io_uring_buf));
+	if(u->buffers && u->buffers != MAP_FAILED)
+		munmap(u->buffers, URING_BUFFERS * URING_BUFFER_SIZE);
+	if(u->fd != -1)
+		close(u->fd);
+}
+
+#endif
+
+#ifdef MLSP_BPF
+
+static int mlsp_bpf(int cmd, union bpf_attr *attr)
+{
+	return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+//loads program, returns its fd or -1
+static int mlsp_bpf_load(int type, int attach_type, const struct bpf_insn *insns, int count)
+{
+	union bpf_attr attr;
+	int fd;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.prog_type = type;
+	attr.expected_attach_type = attach_type;
+	attr.insns = (uint64_t)(uintptr_t)insns;
+	attr.insn_cnt = count;
+	attr.license = (uint64_t)(uintptr_t)"GPL";
+
+	if( (fd = mlsp_bpf(BPF_PROG_LOAD, &attr)) == -1)
+		fprintf(stderr, "mlsp: failed to load BPF program\n");
+
+	return fd;
+}
+
+static int mlsp_bpf_map(int type, int value_size, int entries, int flags)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = type;
+	attr.key_size = sizeof(uint32_t);
+	attr.value_size = value_size;
+	attr.max_entries = entries;
+	attr.map_flags = flags;
+
+	return mlsp_bpf(BPF_MAP_CREATE, &attr);
+}
+
+static int mlsp_bpf_map_update(int map_fd, uint32_t key, uint32_t value)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = map_fd;
+	attr.key = (uint64_t)(uintptr_t)&key;
+	attr.value = (uint64_t)(uintptr_t)&value;
+
+	return mlsp_bpf(BPF_MAP_UPDATE_ELEM, &attr);
+}
+
+//socket filter with the same validation as mlsp_decode_header
+//drops malformed packets and packets older than current frame of sequence
+//map holds mlsp_filter_state per sequence, updated by library
+static int mlsp_filter_program(const struct mlsp *m, int map_fd)
+{
+	//header is copied to stack at H, sequence (map key) is stored at K
+	enum {H = -PACKET_HEADER_SIZE - 4, K = H - 8, PASS = 34, DROP = 36};
+
+	const struct bpf_insn insns[] =
+	{
+		{BPF_ALU64 | BPF_MOV | BPF_X, 6, 1, 0, 0}, //r6 = skb, data starts at UDP header
+		{BPF_ALU64 | BPF_MOV | BPF_K, 2, 0, 0, 8},
+		{BPF_ALU64 | BPF_MOV | BPF_X, 3, 10, 0, 0},
+		{BPF_ALU64 | BPF_ADD | BPF_K, 3, 0, 0, H},
+		{BPF_ALU64 | BPF_MOV | BPF_K, 4, 0, 0, PACKET_HEADER_SIZE},
+		{BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_skb_load_bytes},
+		{BPF_JMP | BPF_JNE | BPF_K, 0, 0, DROP - 7, 0}, //shorter than header
+		{BPF_LDX | BPF_W | BPF_MEM, 2, 6, 0, 0}, //r2 = skb->len
+		{BPF_JMP | BPF_JGT | BPF_K, 2, 0, DROP - 9, 8 + PACKET_HEADER_SIZE + PACKET_MAX_PAYLOAD},
+		{BPF_LDX | BPF_B | BPF_MEM, 2, 10, H + 2, 0}, //r2 = subframes
+		{BPF_JMP | BPF_JEQ | BPF_K, 2, 0, PASS - 11, 0}, //control packet
+		{BPF_JMP | BPF_JGT | BPF_K, 2, 0, DROP - 12, m->subframes},
+		{BPF_LDX | BPF_B | BPF_MEM, 3, 10, H + 3, 0}, //r3 = subframe
+		{BPF_JMP | BPF_JGE | BPF_X, 3, 2, DROP - 14, 0},
+		{BPF_LDX | BPF_H | BPF_MEM, 4, 10, H + 4, 0}, //r4 = packets
+		{BPF_LDX | BPF_H | BPF_MEM, 5, 10, H + 6, 0}, //r5 = packet
+		{BPF_JMP | BPF_JGE | BPF_X, 5, 4, DROP - 17, 0},
+		m->independent_subframes ? //key = sequence of subframe
+		(struct bpf_insn){BPF_STX | BPF_W | BPF_MEM, 10, 3, K, 0} :
+		(struct bpf_insn){BPF_ST | BPF_W | BPF_MEM, 10, 0, K, 0},
+		{BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, map_fd}, //r1 = map
+		{0, 0, 0, 0, 0},
+		{BPF_ALU64 | BPF_MOV | BPF_X, 2, 10, 0, 0},
+		{BPF_ALU64 | BPF_ADD | BPF_K, 2, 0, 0, K},
+		{BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_map_lookup_elem},
+		{BPF_JMP | BPF_JEQ | BPF_K, 0, 0, PASS - 24, 0},
+		{BPF_LDX | BPF_W | BPF_MEM, 2, 0, 0, 0}, //r2 = state session
+		{BPF_JMP | BPF_JEQ | BPF_K, 2, 0, PASS - 26, 0}, //not synchronized
+		{BPF_LDX | BPF_W | BPF_MEM, 3, 10, H + 16, 0}, //r3 = packet session
+		{BPF_JMP | BPF_JNE | BPF_X, 2, 3, PASS - 28, 0}, //new session is never older
+		{BPF_LDX | BPF_W | BPF_MEM, 2, 0, 4, 0}, //r2 = state framenumber
+		{BPF_LDX | BPF_H | BPF_MEM, 3, 10, H, 0}, //r3 = packet framenumber
+		{BPF_ALU64 | BPF_SUB | BPF_X, 2, 3, 0, 0}, //sign extended 16 bit difference
+		{BPF_ALU64 | BPF_LSH | BPF_K, 2, 0, 0, 48},
+		{BPF_ALU64 | BPF_ARSH | BPF_K, 2, 0, 0, 48},
+		{BPF_JMP | BPF_JSGT | BPF_K, 2, 0, DROP - 34, 0}, //current frame is newer
+		{BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, -1}, //PASS, keep whole packet
+		{BPF_JMP | BPF_EXIT, 0, 0, 0, 0},
+		{BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, 0}, //DROP
+		{BPF_JMP | BPF_EXIT, 0, 0, 0, 0},
+	};
+
+	return mlsp_bpf_load(BPF_PROG_TYPE_SOCKET_FILTER, 0, insns, sizeof(insns) / sizeof(insns[0]));
+}
+
+static int mlsp_filter_init(struct mlsp *m)
+{
+	const int sequences = mlsp_sequences(m);
+	const size_t size = sysconf(_SC_PAGESIZE);
+	int prog_fd;
+
+	m->filter_map_fd = mlsp_bpf_map(BPF_MAP_TYPE_ARRAY, sizeof(struct mlsp_filter_state), sequences, BPF_F_MMAPABLE);
+
+	if(m->filter_map_fd == -1)
+	{
+		fprintf(stderr, "mlsp: failed to create kernel filter map\n");
+		return MLSP_ERROR;
+	}
+
+	m->filter_state = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, m->filter_map_fd, 0);
+
+	if(m->filter_state == MAP_FAILED)
+	{
+		m->filter_state = NULL;
+		close(m->filter_map_fd);
+		fprintf(stderr, "mlsp: failed to map kernel filter map\n");
+		return MLSP_ERROR;
+	}
+
+	if( (prog_fd = mlsp_filter_program(m, m->filter_map_fd)) == -1)
+		return MLSP_ERROR;
+
+	//socket keeps the program, map is referenced by program and mmap
+	for(int p=-1;p<m->ports_count;++p)
+		if(setsockopt(p < 0 ? m->socket_udp : m->ports[p].fd, SOL_SOCKET, SO_ATTACH_BPF, &prog_fd, sizeof(prog_fd)) == -1)
+		{
+			close(prog_fd);
+			fprintf(stderr, "mlsp: failed to attach kernel filter to socket\n");
+			return MLSP_ERROR;
+		}
+
+	close(prog_fd);
+
+	for(int s=0;s<sequences;++s)
+		mlsp_filter_update(m, s);
+
+	return MLSP_OK;
+}
+
+static void mlsp_filter_close(struct mlsp *m)
+{
+	if(m->filter_state == NULL)
+		return;
+
+	munmap(m->filter_state, sysconf(_SC_PAGESIZE));
+	close(m->filter_map_fd);
+}
+
+#else
+
+static int mlsp_filter_init(struct mlsp *m)
+{
+	fprintf(stderr, "mlsp: kernel filter not supported on this platform\n");
+	return MLSP_ERROR;
+}
+
+static void mlsp_filter_close(struct mlsp *m)
+{
+}
+
+#endif
+
+#ifdef MLSP_AF_XDP
+
+//XDP program redirecting IPv4 UDP packets to port (without IP options and fragments)
+//to AF_XDP socket of receive queue, everything else goes to network stack
+static int mlsp_xdp_program(int map_fd, uint16_t port)
+{
+	//packet loads are in host order, compare with network order values read the same way
+	const uint16_t ethertype = htons(0x0800), fragment = htons(0x3fff), port_be = htons(port);
+	enum {PASS = 23}; //pass instruction index, jump offsets are relative to next instruction
+
+	const struct bpf_insn insns[] =
+	{
+		{BPF_ALU64 | BPF_MOV | BPF_X, 6, 1, 0, 0}, //r6 = ctx
+		{BPF_LDX | BPF_W | BPF_MEM, 2, 1, 0, 0}, //r2 = data
+		{BPF_LDX | BPF_W | BPF_MEM, 3, 1, 4, 0}, //r3 = data_end
+		{BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0},
+		{BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, 14 + 20 + 8}, //ethernet, IP, UDP headers
+		{BPF_JMP | BPF_JGT | BPF_X, 4, 3, PASS - 6, 0},
+		{BPF_LDX | BPF_H | BPF_MEM, 5, 2, 12, 0},
+		{BPF_JMP | BPF_JNE | BPF_K, 5, 0, PASS - 8, ethertype},
+		{BPF_LDX | BPF_B | BPF_MEM, 5, 2, 14, 0},
+		{BPF_JMP | BPF_JNE | BPF_K, 5, 0, PASS - 10, 0x45}, //IPv4 without options
+		{BPF_LDX | BPF_H | BPF_MEM, 5, 2, 20, 0},
+		{BPF_ALU64 | BPF_AND | BPF_K, 5, 0, 0, fragment},
+		{BPF_JMP | BPF_JNE | BPF_K, 5, 0, PASS - 13, 0}, //not fragmented
+		{BPF_LDX | BPF_B | BPF_MEM, 5, 2, 23, 0},
+		{BPF_JMP | BPF_JNE | BPF_K, 5, 0, PASS - 15, IPPROTO_UDP},
+		{BPF_LDX | BPF_H | BPF_MEM, 5, 2, 36, 0},
+		{BPF_JMP | BPF_JNE | BPF_K, 5, 0, PASS - 17, port_be},
+		{BPF_LDX | BPF_W | BPF_MEM, 2, 6, 16, 0}, //r2 = rx_queue_index
+		{BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, map_fd}, //r1 = map
+		{0, 0, 0, 0, 0},
+		{BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0, XDP_PASS}, //if queue has no socket
+		{BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map},
+		{BPF_JMP | BPF_EXIT, 0, 0, 0, 0},
+		{BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, XDP_PASS}, //PASS
+		{BPF_JMP | BPF_EXIT, 0, 0, 0, 0},
+	};
+
+	return mlsp_bpf_load(BPF_PROG_TYPE_XDP, BPF_XDP, insns, sizeof(insns) / sizeof(insns[0]));
+}
+
+static void mlsp_xdp_fill(struct mlsp_xdp *x, uint64_t frame)
+{
+	const unsigned producer = *x->fill_producer;
+
+	x->fill_addr[producer & (XDP_FRAMES - 1)] = frame;
+	__atomic_store_n(x->fill_producer, producer + 1, __ATOMIC_RELEASE);
+}
+
+static int mlsp_xdp_init(struct mlsp *m, const struct mlsp_config *config)
+{
+	struct mlsp_xdp *x = &m->xdp;
+	struct xdp_umem_reg umem = {0};
+	struct xdp_mmap_offsets off;
+	struct sockaddr_xdp address = {0};
+	socklen_t off_len = sizeof(off);
+	const int rx_entries = XDP_RX_ENTRIES, fill_entries = XDP_FRAMES, completion_entries = 1;
+	const unsigned ifindex = config->interface ? if_nametoindex(config->interface) : 0;
+	union bpf_attr link;
+
+	x->fd = x->map_fd = x->prog_fd = x->link_fd = -1;
+	x->umem = MAP_FAILED;
+	x->rx_ring = x->fill_ring = MAP_FAILED;
+
+	if(ifindex == 0)
+	{
+		fprintf(stderr, "mlsp: AF_XDP backend needs valid interface\n");
+		return MLSP_ERROR;
+	}
+
+	if( (x->fd = socket(AF_XDP, SOCK_RAW, 0)) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to create AF_XDP socket\n");
+		return MLSP_ERROR;
+	}
+
+	x->umem = mmap(NULL, XDP_FRAMES * XDP_FRAME_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if(x->umem == MAP_FAILED)
+	{
+		fprintf(stderr, "mlsp: not enough memory for AF_XDP UMEM\n");
+		return MLSP_ERROR;
+	}
+
+	umem.addr = (uint64_t)(uintptr_t)x->umem;
+	umem.len = XDP_FRAMES * XDP_FRAME_SIZE;
+	umem.chunk_size = XDP_FRAME_SIZE;
+
+	if(setsockopt(x->fd, SOL_XDP, XDP_UMEM_REG, &umem, sizeof(umem)) == -1 ||
+		setsockopt(x->fd, SOL_XDP, XDP_UMEM_FILL_RING, &fill_entries, sizeof(fill_entries)) == -1 ||
+		setsockopt(x->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &completion_entries, sizeof(completion_entries)) == -1 ||
+		setsockopt(x->fd, SOL_XDP, XDP_RX_RING, &rx_entries, sizeof(rx_entries)) == -1 ||
+		getsockopt(x->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &off_len) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to setup AF_XDP UMEM and rings\n");
+		return MLSP_ERROR;
+	}
+
+	x->rx_ring_size = off.rx.desc + XDP_RX_ENTRIES * sizeof(struct xdp_desc);
+	x->fill_ring_size = off.fr.desc + XDP_FRAMES * sizeof(uint64_t);
+	x->rx_ring = mmap(NULL, x->rx_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, x->fd, XDP_PGOFF_RX_RING);
+	x->fill_ring = mmap(NULL, x->fill_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, x->fd, XDP_UMEM_PGOFF_FILL_RING);
+
+	if(x->rx_ring == MAP_FAILED || x->fill_ring == MAP_FAILED)
+	{
+		fprintf(stderr, "mlsp: failed to map AF_XDP rings\n");
+		return MLSP_ERROR;
+	}
+
+	x->rx_producer = (unsigned*)((uint8_t*)x->rx_ring + off.rx.producer);
+	x->rx_consumer = (unsigned*)((uint8_t*)x->rx_ring + off.rx.consumer);
+	x->rx_desc = (struct xdp_desc*)((uint8_t*)x->rx_ring + off.rx.desc);
+	x->fill_producer = (unsigned*)((uint8_t*)x->fill_ring + off.fr.producer);
+	x->fill_consumer = (unsigned*)((uint8_t*)x->fill_ring + off.fr.consumer);
+	x->fill_addr = (uint64_t*)((uint8_t*)x->fill_ring + off.fr.desc);
+
+	for(int i=0;i<XDP_FRAMES;++i)
+		mlsp_xdp_fill(x, (uint64_t)i * XDP_FRAME_SIZE);
+
+	address.sxdp_family = AF_XDP;
+	address.sxdp_flags = XDP_COPY; //generic mode works with any driver
+	address.sxdp_ifindex = ifindex;
+	address.sxdp_queue_id = config->queue;
+
+	if(bind(x->fd, (struct sockaddr*)&address, sizeof(address)) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to bind AF_XDP socket to interface queue\n");
+		return MLSP_ERROR;
+	}
+
+	if( (x->map_fd = mlsp_bpf_map(BPF_MAP_TYPE_XSKMAP, sizeof(uint32_t), config->queue + 1, 0)) == -1 ||
+		mlsp_bpf_map_update(x->map_fd, config->queue, x->fd) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to create AF_XDP socket map\n");
+		return MLSP_ERROR;
+	}
+
+	if( (x->prog_fd = mlsp_xdp_program(x->map_fd, ntohs(m->address_udp.sin_port))) == -1)
+		return MLSP_ERROR;
+
+	memset(&link, 0, sizeof(link));
+	link.link_create.prog_fd = x->prog_fd;
+	link.link_create.target_ifindex = ifindex;
+	link.link_create.attach_type = BPF_XDP;
+	link.link_create.flags = XDP_FLAGS_SKB_MODE;
+
+	if( (x->link_fd = mlsp_bpf(BPF_LINK_CREATE, &link)) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to attach XDP program to interface\n");
+		return MLSP_ERROR;
+	}
+
+	m->poll_fd = x->fd;
+
+	return MLSP_OK;
+}
+
+static void mlsp_xdp_close(struct mlsp *m)
+{
+	struct mlsp_xdp *x = &m->xdp;
+
+	//link first so that interface no longer redirects to socket
+	if(x->link_fd != -1)
+		close(x->link_fd);
+	if(x->prog_fd != -1)
+		close(x->prog_fd);
+	if(x->map_fd != -1)
+		close(x->map_fd);
+	if(x->fd != -1)
+		close(x->fd);
+	if(x->rx_ring != MAP_FAILED)
+		munmap(x->rx_ring, x->rx_ring_size);
+	if(x->fill_ring != MAP_FAILED)
+		munmap(x->fill_ring, x->fill_ring_size);
+	if(x->umem != MAP_FAILED)
+		munmap(x->umem, XDP_FRAMES * XDP_FRAME_SIZE);
+}
+
+//next packet from rx ring, points m->packet to MLSP header in UMEM frame
+static int mlsp_xdp_recv(struct mlsp *m)
+{
+	struct mlsp_xdp *x = &m->xdp;
+
+	while(1)
+	{
+		//previous packet was processed
+		if(x->holding)
+			mlsp_xdp_fill(x, x->frame), x->holding = 0;
+
+		const unsigned consumer = *x->rx_consumer;
+
+		if(consumer == __atomic_load_n(x->rx_producer, __ATOMIC_ACQUIRE))
+		{
+			if(mlsp_poll_packets(m, x->fd) == -1)
+				return -1;
+			continue;
+		}
+
+		const struct xdp_desc desc = x->rx_desc[consumer & (XDP_RX_ENTRIES - 1)];
+		__atomic_store_n(x->rx_consumer, consumer + 1, __ATOMIC_RELEASE);
+
+		x->frame = desc.addr & ~(uint64_t)(XDP_FRAME_SIZE - 1);
+		x->holding = 1;
+
+		//program guarantees ethernet, IPv4 (without options) and UDP headers
+		const uint8_t *udp = x->umem + desc.addr + 14 + 20;
+		const int udp_size = (udp[4] << 8) | udp[5];
+
+		if(udp_size < 8 || 14 + 20 + udp_size > (int)desc.len)
+			continue;
+
+		m->packet = udp + 8;
+
+		return udp_size - 8;
+	}
+}
+
+#endif
+
+#ifdef MLSP_PACKET_RING
+
+static int mlsp_ring_init(struct mlsp *m, const struct mlsp_config *config)
+{
+	struct mlsp_packet_ring *r = &m->ring;
+	const int version = TPACKET_V3, one = 1;
+	struct tpacket_req3 req = {0};
+	struct sockaddr_ll address = {0};
+	const uint32_t ip = ntohl(m->address_udp.sin_addr.s_addr);
+	//IPv4 UDP to port (and address if bound), not fragmented, offsets from IP header
+	struct sock_filter code[] =
+	{
+		BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 9),
+		BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6),
+		BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x3fff, 7, 0),
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 16),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ip, 1, 0),
+		ip == INADDR_ANY ? (struct sock_filter)BPF_STMT(BPF_JMP | BPF_JA, 0) : (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0),
+		BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),
+		BPF_STMT(BPF_LD | BPF_H | BPF_IND, 2),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ntohs(m->address_udp.sin_port), 0, 1),
+		BPF_STMT(BPF_RET | BPF_K, 0xffff),
+		BPF_STMT(BPF_RET | BPF_K, 0),
+	};
+	struct sock_filter drop[] = { BPF_STMT(BPF_RET | BPF_K, 0) };
+	struct sock_fprog filter = {sizeof(code) / sizeof(code[0]), code};
+	struct sock_fprog drop_filter = {1, drop};
+
+	r->fd = -1;
+	r->ring = MAP_FAILED;
+
+	if( (r->fd = socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_IP))) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to create packet socket\n");
+		return MLSP_ERROR;
+	}
+
+	req.tp_block_size = RING_BLOCK_SIZE;
+	req.tp_block_nr = RING_BLOCKS;
+	req.tp_frame_size = RING_FRAME_SIZE;
+	req.tp_frame_nr = RING_BLOCK_SIZE / RING_FRAME_SIZE * RING_BLOCKS;
+	req.tp_retire_blk_tov = RING_BLOCK_TIMEOUT_MS;
+
+	if(setsockopt(r->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == -1 ||
+		setsockopt(r->fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof(one)) == -1 ||
+		setsockopt(r->fd, SOL_SOCKET, SO_ATTACH_FILTER, &filter, sizeof(filter)) == -1 ||
+		setsockopt(r->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to setup packet ring\n");
+		return MLSP_ERROR;
+	}
+
+	r->ring = mmap(NULL, RING_BLOCKS * RING_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, 0);
+
+	if(r->ring == MAP_FAILED)
+	{
+		fprintf(stderr, "mlsp: failed to map packet ring\n");
+		return MLSP_ERROR;
+	}
+
+	address.sll_family = AF_PACKET;
+	address.sll_protocol = htons(ETH_P_IP);
+	address.sll_ifindex = config->interface ? if_nametoindex(config->interface) : 0;
+
+	if(config->interface && address.sll_ifindex == 0)
+	{
+		fprintf(stderr, "mlsp: unknown interface %s\n", config->interface);
+		return MLSP_ERROR;
+	}
+
+	if(bind(r->fd, (struct sockaddr*)&address, sizeof(address)) == -1)
+	{
+		fprintf(stderr, "mlsp: failed to bind packet socket\n");
+		return MLSP_ERROR;
+	}
+
+	//UDP socket stays bound (no ICMP port unreachable) but doesn't queue packets
+	if(setsockopt(m->socket_udp, SOL_SOCKET, SO_ATTACH_FILTER, &drop_filter, sizeof(drop_filter)) == -1)
+		fprintf(stderr, "mlsp: failed to attach drop filter to UDP socket\n");
+
+	m->poll_fd = r->fd;
+
+	return MLSP_OK;
+}
+
+static void mlsp_ring_close(struct mlsp *m)
+{
+	struct mlsp_packet_ring *r = &m->ring;
+
+	if(r->ring != MAP_FAILED)
+		munmap(r->ring, RING_BLOCKS * RING_BLOCK_SIZE);
+	if(r->fd != -1)
+		close(r->fd);
+}
+
+//next packet from ring blocks, points m->packet to MLSP header in block
+static int mlsp_ring_recv(struct mlsp *m)
+{
+	struct mlsp_packet_ring *r = &m->ring;
+
+	while(1)
+	{
+		struct tpacket_block_desc *block = (struct tpacket_block_desc*)(r->ring + r->block * RING_BLOCK_SIZE);
+
+		//all packets of block were processed, return it to kernel
+		if(r->in_block && r->remaining == 0)
+		{
+			__atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+			r->block = (r->block + 1) % RING_BLOCKS;
+			r->in_block = 0;
+			continue;
+		}
+
+		if(!r->in_block)
+		{
+			if( !(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) )
+			{
+				if(mlsp_poll_packets(m, r->fd) == -1)
+					return -1;
+				continue;
+			}
+
+			r->in_block = 1;
+			r->remaining = block->hdr.bh1.num_pkts;
+			r->next = (const uint8_t*)block + block->hdr.bh1.offset_to_first_pkt;
+			continue;
+		}
+
+		const struct tpacket3_hdr *header = (const struct tpacket3_hdr*)r->next;
+
+		r->next += header->tp_next_offset;
+		--r->remaining;
+
+		//filter guarantees unfragmented IPv4 UDP
+		const uint8_t *ip = (const uint8_t*)header + header->tp_net;
+		const int ip_size = (ip[0] & 0x0f) * 4;
+		const uint8_t *udp = ip + ip_size;
+		const int udp_size = (udp[4] << 8) | udp[5];
+
+		if(udp_size < 8 || ip_size + udp_size > (int)header->tp_snaplen)
+			continue;
+
+		m->packet = udp + 8;
+
+		return udp_size - 8;
+	}
+}
+
+#endif
+
+const struct mlsp_frame *mlsp_receive(struct mlsp *m, int *error)
+{
+	int recv_len, sequence;
+	struct mlsp_packet udp;
+	const struct mlsp_frame *partial;
+
+	//receive timeout counts from the call or the last packet
+	if(m->deadline_ms)
+		m->last_packet_ms = mlsp_monotonic_ms();
+
+	while(1)
+	{
+		int wait = MLSP_OK;
+
+		if(m->pending_size)
+		{	//packet that started new frame while partial frame was handed out
+			recv_len = m->pending_size;
+			m->pending_size = 0;
+		}
+		else if(m->deadline_ms && (wait = mlsp_wait(m, &sequence)) != MLSP_OK)
+		{
+			//sender learns about dead link even without packets
+			if(m->report_ms)
+				mlsp_report(m);
+
+			if(wait == MLSP_DEADLINE)
+			{
+				if( (partial = mlsp_expire_frame(m, sequence)) )
+				{
+					*error = MLSP_OK;
+					return partial;
+				}
+				continue;
+			}
+			*error = wait;
+			return NULL;
+		}
+		else if((recv_len = mlsp_recv_packet(m)) == -1)
+		{
+			if(errno==EAGAIN || errno==EWOULDBLOCK || errno==EINPROGRESS)
+			{
+				//hand out what we have, restarted sender is recognized by session
+				if( (partial = mlsp_partial_any(m)) )
+				{
+					*error = MLSP_OK;
+					return partial;
+				}
+				//sender learns about dead link even without packets
+				if(m->report_ms)
+					mlsp_report(m);
+				*error = MLSP_TIMEOUT;
+			}
+			else
+				*error = MLSP_ERROR;
+
+			return NULL;
+		}
+
+		if(m->deadline_ms)
+			m->last_packet_ms = mlsp_monotonic_ms();
+
+		if(recv_len >= PACKET_HEADER_SIZE && m->packet[2] == 0)
+		{	//control packet multiplexed with data
+			mlsp_control_process(m, m->packet, recv_len, mlsp_realtime_us(), &m->source);
+			continue;
+		}
+
+		if(mlsp_decode_header(m, recv_len, &udp) != MLSP_OK)
+			continue;
+
+		//packets dropped before this one was queued, most likely from the assembled frame
+		m->kernel_drops[mlsp_sequence(m, udp.subframe)] += m->unaccounted_drops;
+		m->unaccounted_drops = 0;
+
+		if(udp.session != m->session)
+		{	//sender restarted, hand out what is left from previous session and start over
+			if( (partial = mlsp_partial_any(m)) )
+			{
+				m->pending_size = recv_len;
+				*error = MLSP_OK;
+				return partial;
+			}
+			mlsp_new_session(m, udp.session);
+		}
+
+		sequence = mlsp_sequence(m, udp.subframe);
+
+		if(!m->synchronized[sequence] || mlsp_framenumber_newer(udp.framenumber, m->framenumber[sequence]))
+		{
+			if( (partial = mlsp_partial_frame(m, sequence)) )
+			{	//keep the packet for the next call
+				m->pending_size = recv_len;
+				*error = MLSP_OK;
+				return partial;
+			}
+			mlsp_frame_stats(m, sequence, &udp);
+			mlsp_new_frame(m, sequence, udp.framenumber);
+		}
+
+		m->frame_subframes = udp.subframes;
+
+		struct mlsp_collected_frame *collected = &m->collected[udp.subframe];
+
+		if(m->transffered_subframes[udp.subframe])
+			continue; //late packet of subframe already handed out (or dropped)
+
+		if(m->deadline_ms && !m->frame_start_ms[sequence])
+			m->frame_start_ms[sequence] = m->last_packet_ms;
+
+		if( collected->data == NULL || collected->packets != udp.packets)
+			if( ( *error = mlsp_new_subframe(collected, &udp) ) != MLSP_OK)
+				return NULL;
+
+		if(collected->received_packets[udp.packet])
+		{	//expected with redundant paths or ports, the first copy wins
+			++m->duplicates[sequence];
+			continue;
+		}
+
+		collected->received_packets[udp.packet] = 1;
+		m->copy(collected->data + udp.packet*PACKET_MAX_PAYLOAD, udp.data, udp.size);
+
+		++collected->collected_packets;
+		collected->actual_size += udp.size;
+		collected->timestamp = udp.timestamp;
+		++m->stats.received_packets;
+		m->stats.received_bytes += PACKET_HEADER_SIZE + udp.size;
+
+		if(m->report_ms)
+			mlsp_report(m);
+
+		if(udp.packet == udp.packets - 1)
+			collected->last_packet_size = udp.size;
+
+		if(udp.packet == collected->contiguous_packets)
+			mlsp_prefix(m, &udp);
+
+		if(collected->collected_packets == udp.packets)
+		{
+			m->transffered_subframes[udp.subframe] = 1;
+			++m->stats.completed_frames;
+
+			const int complete = mlsp_sequence_complete(m, sequence);
+
+			if(complete)
+				m->frame_start_ms[sequence] = 0;
+
+			if(m->subframe_delivery)
+			{
+				mlsp_decode_subframe(m, udp.subframe, udp.subframes);
+				return &m->frame[udp.subframe];
+			}
+
+			if(!complete)
+				continue;
+
+			mlsp_decode_payload(m, udp.subframes);
+
+			return m->frame;
+		}
+	}
+}
+
+static int mlsp_decode_header(struct mlsp *m, int size, struct mlsp_packet *udp)
+{
+	const uint8_t *data = m->packet;
+
+	if(size < PACKET_HEADER_SIZE)
+	{
+		fprintf(stderr, "mlsp: packet size smaller than MLSP header\n");
+		return MLSP_ERROR;
+	}
+
+	memcpy(&udp->framenumber, data, sizeof(udp->framenumber));
+	udp->subframes = data[2];
+	udp->subframe = data[3];
+	memcpy(&udp->packets, data+4, sizeof(udp->packets));
+	memcpy(&udp->packet, data+6, sizeof(udp->packet));
+	memcpy(&udp->timestamp, data+8, sizeof(udp->timestamp));
+	memcpy(&udp->session, data+16, sizeof(udp->session));
+	memcpy(&udp->send_time, data+20, sizeof(udp->send_time));
+
+	udp->size = size - PACKET_HEADER_SIZE;
+
+	if(udp->size > PACKET_MAX_PAYLOAD)
+	{
+		fprintf(stderr, "mlsp: packet paylod size would exceed max paylod\n");
+		return MLSP_ERROR;
+	}
+
+	if(udp->subframe >= udp->subframes)
+	{
+		fprintf(stderr, "mlsp: decoded packet would exceed frame subframes\n");
+		return MLSP_ERROR;
+	}
+
+	if(udp->packet >= udp->packets)
+	{
+		fprintf(stderr, "mlsp: decoded packet would exceed frame packets\n");
+		return MLSP_ERROR;
+	}
+
+	if(udp->subframes > m->subframes || udp->subframe >= m->subframes)
+	{
+		fprintf(stderr, "mlsp: ignoring packet with incorrect subframe(s)\n");
+		return MLSP_ERROR;
+	}
+
+	const int sequence = mlsp_sequence(m, udp->subframe);
+
+	//packets from new session are never older
+	//late copies from slower port or path are expected, counted instead of logged
+	if(udp->session == m->session && m->synchronized[sequence] && mlsp_framenumber_newer(m->framenumber[sequence], udp->framenumber))
+	{
+		++m->late_packets[sequence];
+		return MLSP_ERROR;
+	}
+
+	udp->data = data + PACKET_HEADER_SIZE;
+	return MLSP_OK;
+}
+
+static void mlsp_decode_payload(struct mlsp *m, int subframes)
+{
+	for(int i=0;i<m->subframes;++i)
+		mlsp_decode_subframe(m, i, subframes);
+}
+
+static void mlsp_decode_subframe(struct mlsp *m, int subframe, int subframes)
+{
+	const struct mlsp_collected_frame *collected = &m->collected[subframe];
+	struct mlsp_frame *frame = &m->frame[subframe];
+
+	frame->framenumber = m->framenumber[mlsp_sequence(m, subframe)];
+	frame->subframe = subframe;
+	frame->kernel_drops = m->kernel_drops[mlsp_sequence(m, subframe)];
+	frame->duplicate_packets = m->duplicates[mlsp_sequence(m, subframe)];
+	frame->late_packets = m->late_packets[mlsp_sequence(m, subframe)];
+
+	//note - we accept lower number of subframes from sender then initialized for receiver
+	if(subframe >= subframes || collected->packets == 0)
+	{
+		frame->data = NULL;
+		frame->size = frame->packets = frame->collected_packets = 0;
+		frame->received_packets = NULL;
+		frame->timestamp = 0;
+		return;
+	}
+
+	frame->data = collected->data;
+	frame->packets = collected->packets;
+	frame->collected_packets = collected->collected_packets;
+	frame->received_packets = collected->received_packets;
+	frame->timestamp = collected->timestamp;
+
+	//partial frame spans up to the end of last packet or all the packets if it was lost
+	if(collected->collected_packets == collected->packets)
+		frame->size = collected->actual_size;
+	else if(collected->last_packet_size)
+		frame->size = (collected->packets - 1) * PACKET_MAX_PAYLOAD + collected->last_packet_size;
+	else
+		frame->size = collected->packets * PACKET_MAX_PAYLOAD;
+}
+
+//subframes share single framenumber sequence unless independent_subframes is set
+static int mlsp_sequence(const struct mlsp *m, int subframe)
+{
+	return m->independent_subframes ? subframe : 0;
+}
+
+static int mlsp_sequences(const struct mlsp *m)
+{
+	return m->independent_subframes ? m->subframes : 1;
+}
+
+//returns the first subframe of sequence, last is one past the last
+static int mlsp_sequence_subframes(const struct mlsp *m, int sequence, int *last)
+{
+	*last = m->independent_subframes ? sequence + 1 : m->subframes;
+	return m->independent_subframes ? sequence : 0;
+}
+
+//all subframes of currently assembled frame of sequence handed out (or dropped)
+static int mlsp_sequence_complete(const struct mlsp *m, int sequence)
+{
+	int transferred = 0, last;
+	int first = mlsp_sequence_subframes(m, sequence, &last);
+
+	//receiver may be configured for more subframes than sent
+	if(!m->independent_subframes && last > m->frame_subframes)
+		last = m->frame_subframes;
+
+	for(int s=first;s<last;++s)
+		transferred += m->transffered_subframes[s];
+
+	return transferred == (m->independent_subframes ? 1 : m->frame_subframes);
+}
+
+//advances in-order prefix of subframe and notifies the user
+static void mlsp_prefix(struct mlsp *m, const struct mlsp_packet *udp)
+{
+	struct mlsp_collected_frame *collected = &m->collected[udp->subframe];
+	struct mlsp_frame prefix = {0};
+
+	while(collected->contiguous_packets < collected->packets && collected->received_packets[collected->contiguous_packets])
+		++collected->contiguous_packets;
+
+	if(m->prefix_callback == NULL)
+		return;
+
+	prefix.data = collected->data;
+	//all but the last packet carry max payload
+	prefix.size = collected->contiguous_packets == collected->packets ?
+		collected->actual_size : collected->contiguous_packets * PACKET_MAX_PAYLOAD;
+	prefix.framenumber = udp->framenumber;
+	prefix.subframe = udp->subframe;
+	prefix.packets = collected->packets;
+	prefix.collected_packets = collected->contiguous_packets;
+	prefix.received_packets = collected->received_packets;
+
+	m->prefix_callback(&prefix, m->prefix_user);
+}
+
+//prepares incomplete frame (or subframe) of sequence for the user if partial frames are enabled
+//returns what is to be handed out or NULL if there is nothing
+static const struct mlsp_frame *mlsp_partial_frame(struct mlsp *m, int sequence)
+{
+	int started = 0, last;
+	const int first = mlsp_sequence_subframes(m, sequence, &last);
+
+	if(!m->partial_frames || mlsp_sequence_complete(m, sequence))
+		return NULL;
+
+	for(int s=first;s<last;++s)
+	{
+		if(!m->collected[s].packets)
+			continue;
+
+		if(m->subframe_delivery && !m->transffered_subframes[s])
+		{	//one subframe at a time, the rest on following calls
+			mlsp_decode_subframe(m, s, m->frame_subframes);
+			m->transffered_subframes[s] = 1;
+
+			if(mlsp_sequence_complete(m, sequence))
+				m->frame_start_ms[sequence] = 0;
+
+			return &m->frame[s];
+		}
+
+		++started;
+	}
+
+	if(!started || m->subframe_delivery)
+		return NULL;
+
+	mlsp_decode_payload(m, m->frame_subframes);
+	//mark as handed out, frame is not delivered twice
+	memset(m->transffered_subframes, 1, MLSP_MAX_SUBFRAMES);
+	m->frame_start_ms[sequence] = 0;
+
+	return m->frame;
+}
+
+//waits for packet, receive timeout or deadline of currently assembled frame
+//on MLSP_DEADLINE sequence is set to the one with expired frame
+static int mlsp_wait(struct mlsp *m, int *sequence)
+{
+	struct pollfd pfd = {m->poll_fd, POLLIN, 0};
+	const int sequences = mlsp_sequences(m);
+	int spun = 0;
+
+	while(1)
+	{
+		const uint64_t now = mlsp_monotonic_ms();
+		int wait = -1, deadline = 0, result;
+
+		if(m->timeout_ms > 0)
+			wait = m->last_packet_ms + m->timeout_ms > now ? m->last_packet_ms + m->timeout_ms - now : 0;
+
+		for(int s=0;s<sequences;++s)
+		{
+			if(!m->frame_start_ms[s])
+				continue;
+
+			int left = m->frame_start_ms[s] + m->deadline_ms > now ? m->frame_start_ms[s] + m->deadline_ms - now : 0;
+
+			if(wait == -1 || left <= wait)
+				wait = left, deadline = 1, *sequence = s;
+		}
+
+		//spin once before blocking, waits are recomputed after
+		if(m->spin_us && !spun)
+		{
+			spun = 1;
+
+			if(mlsp_spin(m, &pfd))
+				return MLSP_OK;
+
+			continue;
+		}
+
+		if( (result = poll(&pfd, 1, wait)) > 0)
+			return MLSP_OK;
+
+		if(result == 0)
+			return deadline ? MLSP_DEADLINE : MLSP_TIMEOUT;
+
+		if(errno != EINTR)
+		{
+			fprintf(stderr, "mlsp: failed to wait for data\n");
+			return MLSP_ERROR;
+		}
+	}
+}
+
+//returns frame (or subframe) past deadline to be handed out partially or NULL if it is dropped
+static const struct mlsp_frame *mlsp_expire_frame(struct mlsp *m, int sequence)
+{
+	const struct mlsp_frame *partial = mlsp_partial_frame(m, sequence);
+	int first, last;
+
+	if(partial)
+		return partial;
+
+	fprintf(stderr, "mlsp: dropping frame %d past deadline\n", m->framenumber[sequence]);
+
+	//mark as handed out so that late packets are ignored
+	first = mlsp_sequence_subframes(m, sequence, &last);
+	memset(m->transffered_subframes + first, 1, last - first);
+	m->frame_start_ms[sequence] = 0;
+
+	return NULL;
+}
+
+static uint64_t mlsp_monotonic_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint64_t mlsp_monotonic_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t mlsp_realtime_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//serial number arithmetic, framenumber wraps around
+static int mlsp_framenumber_newer(uint16_t framenumber, uint16_t current)
+{
+	return (int16_t)(framenumber - current) > 0;
+}
+
+//first incomplete frame (or subframe) of any sequence to be handed out or NULL
+static const struct mlsp_frame *mlsp_partial_any(struct mlsp *m)
+{
+	const struct mlsp_frame *partial = NULL;
+
+	for(int s=0;s<mlsp_sequences(m) && partial == NULL;++s)
+		partial = mlsp_partial_frame(m, s);
+
+	return partial;
+}
+
+//forgets the state of all sequences, session 0 means unknown
+static void mlsp_new_session(struct mlsp *m, uint32_t session)
+{
+	if(m->session && session)
+		fprintf(stderr, "mlsp: new streaming session, resetting stream state\n");
+
+	for(int s=0;s<mlsp_sequences(m);++s)
+	{
+		mlsp_new_frame(m, s, 0);
+		m->synchronized[s] = 0;
+		mlsp_filter_update(m, s);
+	}
+
+	m->session = session;
+}
+
+//publishes current frame of sequence to kernel filter
+static void mlsp_filter_update(struct mlsp *m, int sequence)
+{
+	struct mlsp_filter_state state = {m->synchronized[sequence] ? m->session : 0, m->framenumber[sequence]};
+	uint64_t value;
+
+	if(m->filter_state == NULL)
+		return;
+
+	//single store so that filter never sees mixed state
+	memcpy(&value, &state, sizeof(value));
+	__atomic_store_n(&m->filter_state[sequence], value, __ATOMIC_RELAXED);
+}
+
+static void mlsp_new_frame(struct mlsp *m, int sequence, uint16_t framenumber)
+{
+	int last;
+	const int first = mlsp_sequence_subframes(m, sequence, &last);
+
+	if(m->synchronized[sequence])
+		for(int s=first;s<last;++s)
+			if(m->collected[s].collected_packets < m->collected[s].packets)
+			{	//lost packets also of partial frames handed out
+				++m->stats.dropped_frames;
+				m->stats.lost_packets += m->collected[s].packets - m->collected[s].collected_packets;
+			}
+
+	if(m->synchronized[sequence])
+		for(int s=first;s<last;++s)
+			if(!m->transffered_subframes[s] && m->collected[s].packets)
 			{
 				fprintf(stderr, "mlsp: ignoring incomplete frame %d/%d: %d/%d\n", framenumber, s,
 				m->collected[s].collected_packets, m->collected[s].packets);
@@ -389,25 +3420,398 @@ static void mlsp_new_frame(struct mlsp *m, uint16_t framenumber)
 				fprintf(stderr, "\n");
 			}
 
-	m->framenumber = framenumber;
-	memset(m->transffered_subframes, 0, MLSP_MAX_SUBFRAMES);
+	m->framenumber[sequence] = framenumber;
+	m->synchronized[sequence] = 1;
+	m->frame_start_ms[sequence] = 0;
+	m->kernel_drops[sequence] = 0;
+	m->duplicates[sequence] = 0;
+	m->late_packets[sequence] = 0;
+	memset(m->transffered_subframes + first, 0, last - first);
+	mlsp_filter_update(m, sequence);
 
-	for(int s=0;s<m->subframes;++s)
+	for(int s=first;s<last;++s)
 	{
 		m->collected[s].actual_size = 0;
 		m->collected[s].packets = 0;
 		m->collected[s].collected_packets = 0;
+		m->collected[s].last_packet_size = 0;
+		m->collected[s].contiguous_packets = 0;
 
 		if(m->collected[s].received_packets)
 			memset(m->collected[s].received_packets, 0, m->collected[s].received_packets_size);
 	}
 }
 
+//frames skipped entirely and jitter of frame arrival relative to sender send time
+static void mlsp_frame_stats(struct mlsp *m, int sequence, const struct mlsp_packet *udp)
+{
+	const int64_t transit = (int64_t)(mlsp_realtime_us() - udp->send_time);
+	int last;
+	const int first = mlsp_sequence_subframes(m, sequence, &last);
+
+	if(m->synchronized[sequence])
+		m->stats.dropped_frames += ((int16_t)(udp->framenumber - m->framenumber[sequence]) - 1) * (last - first);
+
+	//RFC 3550 interarrival jitter, clock offset cancels out
+	if(m->transit_us)
+	{
+		const int64_t d = transit > m->transit_us ? transit - m->transit_us : m->transit_us - transit;
+		m->stats.jitter_us += (d - (int64_t)m->stats.jitter_us) / 16;
+	}
+
+	//minimum in report interval filters out jitter from delay trend
+	if(!m->transit_sampled || transit < m->stats.min_transit_us)
+		m->stats.min_transit_us = transit;
+
+	m->transit_sampled = 1;
+	m->transit_us = transit;
+	m->stats.framenumber = udp->framenumber;
+}
+
+//sends statistics back to the source of the last packet every report_ms
+static void mlsp_report(struct mlsp *m)
+{
+	const uint64_t now = mlsp_monotonic_ms();
+	uint8_t data[PACKET_HEADER_SIZE + CONTROL_REPORT_SIZE];
+	struct mlsp_packet control = {0};
+	const struct mlsp_report *s = &m->stats;
+
+	//nobody to report to before the first packet
+	if(now < m->report_next_ms || !m->source.sin_port)
+		return;
+
+	m->report_next_ms = now + m->report_ms;
+
+	control.framenumber = s->framenumber;
+	control.subframe = CONTROL_REPORT;
+	control.packet = m->report_sequence++;
+	control.timestamp = mlsp_realtime_us();
+	control.session = m->session;
+
+	mlsp_encode_header(data, &control);
+	memcpy(data + PACKET_HEADER_SIZE, &s->received_packets, sizeof(uint32_t));
+	memcpy(data + PACKET_HEADER_SIZE + 4, &s->lost_packets, sizeof(uint32_t));
+	memcpy(data + PACKET_HEADER_SIZE + 8, &s->completed_frames, sizeof(uint32_t));
+	memcpy(data + PACKET_HEADER_SIZE + 12, &s->dropped_frames, sizeof(uint32_t));
+	memcpy(data + PACKET_HEADER_SIZE + 16, &s->jitter_us, sizeof(uint32_t));
+	memcpy(data + PACKET_HEADER_SIZE + 20, &s->received_bytes, sizeof(uint64_t));
+	memcpy(data + PACKET_HEADER_SIZE + 28, &s->min_transit_us, sizeof(int64_t));
+
+	m->transit_sampled = 0;
+
+	if(sendto(m->socket_udp, data, sizeof(data), MSG_DONTWAIT, (struct sockaddr*)&m->source, sizeof(m->source)) == -1)
+		fprintf(stderr, "mlsp: failed to send report\n");
+}
+
+int mlsp_get_report(struct mlsp *m, struct mlsp_report *report)
+{
+	if(mlsp_control_recv(m) != MLSP_OK)
+		return MLSP_ERROR;
+
+	*report = m->report;
+
+	if(!m->report_new)
+		return MLSP_TIMEOUT;
+
+	m->report_new = 0;
+
+	return MLSP_OK;
+}
+
+//reads control packets sent back by receiver without blocking
+static int mlsp_control_recv(struct mlsp *m)
+{
+	uint8_t data[PACKET_HEADER_SIZE + PACKET_MAX_PAYLOAD];
+	uint8_t control[CMSG_SPACE(sizeof(struct timeval))];
+	struct iovec iov = {data, sizeof(data)};
+	struct sockaddr_in source;
+
+	for(int p=-1;p<m->paths_count;++p)
+	{
+		const int fd = p < 0 ? m->socket_udp : m->paths[p];
+		struct msghdr msg = {0};
+		int size;
+
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+
+		while(1)
+		{
+			msg.msg_name = &source;
+			msg.msg_namelen = sizeof(source);
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+
+			if( (size = recvmsg(fd, &msg, MSG_DONTWAIT)) != -1)
+			{
+				uint64_t arrival_us = 0;
+
+				for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+					if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP)
+					{
+						struct timeval tv;
+
+						memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+						arrival_us = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+					}
+
+				mlsp_control_process(m, data, size, arrival_us ? arrival_us : mlsp_realtime_us(), &source);
+				continue;
+			}
+
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			//pending ICMP port unreachable of earlier packet
+			if(errno == EINTR || errno == ECONNREFUSED)
+				continue;
+
+			fprintf(stderr, "mlsp: failed to receive control data\n");
+			return MLSP_ERROR;
+		}
+	}
+
+	return MLSP_OK;
+}
+
+static void mlsp_control_process(struct mlsp *m, const uint8_t *data, int size, uint64_t arrival_us, const struct sockaddr_in *source)
+{
+	uint32_t session;
+
+	if(size < PACKET_HEADER_SIZE || data[2] != 0)
+		return;
+
+	//receiver answers pings of any session
+	if(data[3] == CONTROL_PING && size >= PACKET_HEADER_SIZE + CONTROL_PING_SIZE)
+	{
+		mlsp_pong(m, data, arrival_us);
+		return;
+	}
+
+	memcpy(&session, data + 16, sizeof(session));
+
+	//reports and pongs of previous sender instances are ignored
+	if(session != m->session)
+		return;
+
+	if(data[3] == CONTROL_PONG && size >= PACKET_HEADER_SIZE + CONTROL_PONG_SIZE)
+	{
+		mlsp_clock_sample(m, data, arrival_us);
+		return;
+	}
+
+	if(data[3] == CONTROL_REPORT && size >= PACKET_HEADER_SIZE + CONTROL_REPORT_SIZE)
+	{
+		const uint64_t now_ms = mlsp_monotonic_ms();
+		struct mlsp_receiver *receiver = mlsp_report_receiver(m, source, now_ms);
+		const struct mlsp_report previous = receiver->report;
+		struct mlsp_report report, *r = &report;
+		uint16_t sequence;
+
+		memcpy(&sequence, data + 6, sizeof(sequence));
+
+		//reordered or duplicated report, restarted receiver starts over after timeout
+		if(previous.timestamp && receiver->report_ms + REPORT_TIMEOUT_MS >= now_ms &&
+			!mlsp_framenumber_newer(sequence, receiver->report_sequence))
+			return;
+
+		memcpy(&r->framenumber, data, sizeof(r->framenumber));
+		memcpy(&r->timestamp, data + 8, sizeof(r->timestamp));
+		memcpy(&r->received_packets, data + PACKET_HEADER_SIZE, sizeof(uint32_t));
+		memcpy(&r->lost_packets, data + PACKET_HEADER_SIZE + 4, sizeof(uint32_t));
+		memcpy(&r->completed_frames, data + PACKET_HEADER_SIZE + 8, sizeof(uint32_t));
+		memcpy(&r->dropped_frames, data + PACKET_HEADER_SIZE + 12, sizeof(uint32_t));
+		memcpy(&r->jitter_us, data + PACKET_HEADER_SIZE + 16, sizeof(uint32_t));
+		memcpy(&r->received_bytes, data + PACKET_HEADER_SIZE + 20, sizeof(uint64_t));
+		memcpy(&r->min_transit_us, data + PACKET_HEADER_SIZE + 28, sizeof(int64_t));
+		m->report = *r;
+		m->report_new = 1;
+
+		receiver->report = *r;
+		receiver->report_ms = now_ms;
+		receiver->report_sequence = sequence;
+
+		//the first report and receiver clock step give no interval
+		if(previous.timestamp == 0 || r->timestamp <= previous.timestamp)
+			return;
+
+		receiver->target_bitrate = mlsp_estimate(m, receiver->target_bitrate, &previous, r);
+
+		//follow the slowest receiver still reporting
+		m->target_bitrate = receiver->target_bitrate;
+
+		for(int i=0;i<REPORT_RECEIVERS;++i)
+			if(m->receivers[i].address.sin_family && m->receivers[i].report_ms + REPORT_TIMEOUT_MS >= now_ms &&
+				m->receivers[i].target_bitrate < m->target_bitrate)
+				m->target_bitrate = m->receivers[i].target_bitrate;
+	}
+}
+
+//estimator state of report source, new receiver starts at current target
+//in place of unused or the longest silent receiver
+static struct mlsp_receiver *mlsp_report_receiver(struct mlsp *m, const struct sockaddr_in *source, uint64_t now_ms)
+{
+	struct mlsp_receiver *oldest = &m->receivers[0];
+
+	for(int i=0;i<REPORT_RECEIVERS;++i)
+	{
+		struct mlsp_receiver *r = &m->receivers[i];
+
+		if(r->address.sin_family && r->address.sin_addr.s_addr == source->sin_addr.s_addr && r->address.sin_port == source->sin_port)
+			return r;
+
+		if(r->report_ms < oldest->report_ms)
+			oldest = r;
+	}
+
+	memset(oldest, 0, sizeof(*oldest));
+	oldest->address = *source;
+	oldest->address.sin_family = AF_INET;
+	oldest->target_bitrate = m->target_bitrate;
+	oldest->report_ms = now_ms;
+
+	return oldest;
+}
+
+//sends ping with current estimate every ping_ms
+static void mlsp_ping(struct mlsp *m)
+{
+	const uint64_t now = mlsp_monotonic_ms();
+	uint8_t data[PACKET_HEADER_SIZE + CONTROL_PING_SIZE];
+	struct mlsp_packet control = {0};
+
+	if(now < m->ping_next_ms)
+		return;
+
+	m->ping_next_ms = now + m->ping_ms;
+
+	control.subframe = CONTROL_PING;
+	control.timestamp = mlsp_realtime_us();
+	control.session = m->session;
+
+	mlsp_encode_header(data, &control);
+	memcpy(data + PACKET_HEADER_SIZE, &m->clock.offset_us, sizeof(int64_t));
+	memcpy(data + PACKET_HEADER_SIZE + 8, &m->clock.rtt_us, sizeof(uint32_t));
+
+	if(sendto(m->socket_udp, data, sizeof(data), MSG_DONTWAIT, m->connected ? NULL : (struct sockaddr*)&m->address_udp,
+		m->connected ? 0 : sizeof(m->address_udp)) == -1 && errno != ECONNREFUSED)
+		fprintf(stderr, "mlsp: failed to send ping\n");
+}
+
+//receiver: answers ping with its receive and send time, learns sender estimate
+static void mlsp_pong(struct mlsp *m, const uint8_t *data, uint64_t arrival_us)
+{
+	uint8_t pong[PACKET_HEADER_SIZE + CONTROL_PONG_SIZE];
+	struct mlsp_clock clock;
+	uint64_t sent_us;
+
+	memcpy(&clock.offset_us, data + PACKET_HEADER_SIZE, sizeof(int64_t));
+	memcpy(&clock.rtt_us, data + PACKET_HEADER_SIZE + 8, sizeof(uint32_t));
+
+	if(clock.rtt_us)
+		m->clock = clock;
+
+	//source is not known with AF_XDP and packet ring backends
+	if(m->source.sin_family != AF_INET)
+		return;
+
+	memcpy(pong, data, PACKET_HEADER_SIZE);
+	pong[3] = CONTROL_PONG;
+	sent_us = mlsp_realtime_us();
+	memcpy(pong + PACKET_HEADER_SIZE, &arrival_us, sizeof(uint64_t));
+	memcpy(pong + PACKET_HEADER_SIZE + 8, &sent_us, sizeof(uint64_t));
+
+	if(sendto(m->socket_udp, pong, sizeof(pong), MSG_DONTWAIT, (struct sockaddr*)&m->source, sizeof(m->source)) == -1)
+		fprintf(stderr, "mlsp: failed to send pong\n");
+}
+
+//NTP-style sample, the one with the lowest round trip time has the least asymmetric queueing
+static void mlsp_clock_sample(struct mlsp *m, const uint8_t *data, uint64_t arrival_us)
+{
+	uint64_t ping_us, receive_us, send_us;
+	struct mlsp_clock *sample = &m->clock_samples[m->clock_sample];
+
+	memcpy(&ping_us, data + 8, sizeof(uint64_t));
+	memcpy(&receive_us, data + PACKET_HEADER_SIZE, sizeof(uint64_t));
+	memcpy(&send_us, data + PACKET_HEADER_SIZE + 8, sizeof(uint64_t));
+
+	const int64_t rtt = (int64_t)(arrival_us - ping_us) - (int64_t)(send_us - receive_us);
+
+	if(rtt < 0 || rtt > UINT32_MAX)
+		return;
+
+	sample->rtt_us = rtt > 0 ? rtt : 1;
+	sample->offset_us = ((int64_t)(receive_us - ping_us) + (int64_t)(send_us - arrival_us)) / 2;
+	m->clock_sample = (m->clock_sample + 1) % CLOCK_SAMPLES;
+
+	m->clock = *sample;
+
+	for(int i=0;i<CLOCK_SAMPLES;++i)
+		if(m->clock_samples[i].rtt_us && m->clock_samples[i].rtt_us < m->clock.rtt_us)
+			m->clock = m->clock_samples[i];
+}
+
+int mlsp_get_clock(struct mlsp *m, struct mlsp_clock *clock)
+{
+	if(m->ping_ms && mlsp_control_recv(m) != MLSP_OK)
+		return MLSP_ERROR;
+
+	*clock = m->clock;
+
+	return m->clock.rtt_us ? MLSP_OK : MLSP_TIMEOUT;
+}
+
+uint32_t mlsp_get_target_bitrate(struct mlsp *m)
+{
+	mlsp_control_recv(m);
+
+	return m->target_bitrate;
+}
+
+//delay gradient and loss based AIMD over interval between reports
+static uint32_t mlsp_estimate(const struct mlsp *m, uint32_t target_bitrate, const struct mlsp_report *previous, const struct mlsp_report *report)
+{
+	const uint64_t interval_us = report->timestamp - previous->timestamp;
+	const uint32_t received = report->received_packets - previous->received_packets;
+	const uint32_t lost = report->lost_packets - previous->lost_packets;
+	const uint64_t bytes = report->received_bytes - previous->received_bytes;
+	//queue growth, clock offset between sender and receiver cancels out
+	const int64_t gradient_us = report->min_transit_us - previous->min_transit_us;
+	const uint64_t loss = received + lost ? 1000ULL * lost / (received + lost) : 0;
+	const uint64_t receive_bitrate = bytes * 8 * 1000000 / interval_us;
+	uint64_t target = target_bitrate;
+
+	if(!received && !m->independent_subframes && mlsp_framenumber_newer(m->framenumber[0], report->framenumber))
+		target /= 2; //frames sent since receiver got anything, link is down
+	else if(gradient_us > ESTIMATOR_OVERUSE_US || loss > ESTIMATOR_DECREASE_LOSS)
+	{	//back off below what actually got through
+		const uint64_t decreased = receive_bitrate * 85 / 100;
+
+		if(decreased < target)
+			target = decreased;
+	}
+	else if(loss < ESTIMATOR_INCREASE_LOSS)
+	{	//don't grow far above what the link delivered when stream fills the estimate
+		const uint64_t increased = target + target * ESTIMATOR_INCREASE_PERCENT * interval_us / 100 / 1000000;
+		const uint64_t limit = receive_bitrate * 3 / 2 > target ? receive_bitrate * 3 / 2 : target;
+
+		target = increased < limit ? increased : limit;
+	}
+
+	if(target < m->min_bitrate)
+		target = m->min_bitrate;
+	if(target > m->max_bitrate)
+		target = m->max_bitrate;
+
+	return target;
+}
+
 static int mlsp_new_subframe(struct mlsp_collected_frame *collected, struct mlsp_packet *udp)
 {
 	collected->actual_size = 0;
 	collected->packets = udp->packets;
 	collected->collected_packets = 0;
+	collected->last_packet_size = 0;
+	collected->contiguous_packets = 0;
 
 	if(collected->reserved_size < udp->packets * PACKET_MAX_PAYLOAD)
 	{
@@ -435,3 +3839,131 @@ static int mlsp_new_subframe(struct mlsp_collected_frame *collected, struct mlsp
 
 	return MLSP_OK;
 }
+
+int mlsp_frame_holes(const struct mlsp_frame *frame, struct mlsp_hole *holes, int max_holes)
+{
+	int count = 0;
+	uint32_t hole_end = UINT32_MAX; //end of the last found hole
+
+	for(uint32_t p=0;p<frame->packets;++p)
+	{
+		if(frame->received_packets[p])
+			continue;
+
+		const uint32_t offset = p * PACKET_MAX_PAYLOAD;
+		const uint32_t end = offset + PACKET_MAX_PAYLOAD < frame->size ? offset + PACKET_MAX_PAYLOAD : frame->size;
+
+		if(offset == hole_end)
+		{	//consecutive lost packets form single hole
+			if(count <= max_holes)
+				holes[count-1].size += end - offset;
+		}
+		else
+		{
+			if(count < max_holes)
+			{
+				holes[count].offset = offset;
+				holes[count].size = end - offset;
+			}
+			++count;
+		}
+
+		hole_end = end;
+	}
+
+	return count;
+}
+
+#ifdef MLSP_X86_STREAMING_STORES
+
+//streaming stores require aligned destination, unaligned head and short tail go through memcpy
+//the consumer (e.g. hardware decoder) typically doesn't read frame data through CPU cache
+
+__attribute__((target("sse2")))
+static void *mlsp_copy_sse2_nontemporal(void *dest, const void *src, size_t n)
+{
+	uint8_t *d = (uint8_t*)dest;
+	const uint8_t *s = (const uint8_t*)src;
+	size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+
+	if(head > n)
+		head = n;
+
+	memcpy(d, s, head);
+	d += head, s += head, n -= head;
+
+	for(; n >= 64; d += 64, s += 64, n -= 64)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)s);
+		__m128i b = _mm_loadu_si128((const __m128i*)(s + 16));
+		__m128i c = _mm_loadu_si128((const __m128i*)(s + 32));
+		__m128i e = _mm_loadu_si128((const __m128i*)(s + 48));
+		_mm_stream_si128((__m128i*)d, a);
+		_mm_stream_si128((__m128i*)(d + 16), b);
+		_mm_stream_si128((__m128i*)(d + 32), c);
+		_mm_stream_si128((__m128i*)(d + 48), e);
+	}
+
+	for(; n >= 16; d += 16, s += 16, n -= 16)
+		_mm_stream_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+
+	memcpy(d, s, n);
+	//make streaming stores globally visible before data is handed out
+	_mm_sfence();
+
+	return dest;
+}
+
+__attribute__((target("avx2")))
+static void *mlsp_copy_avx2_nontemporal(void *dest, const void *src, size_t n)
+{
+	uint8_t *d = (uint8_t*)dest;
+	const uint8_t *s = (const uint8_t*)src;
+	size_t head = (32 - ((uintptr_t)d & 31)) & 31;
+
+	if(head > n)
+		head = n;
+
+	memcpy(d, s, head);
+	d += head, s += head, n -= head;
+
+	for(; n >= 128; d += 128, s += 128, n -= 128)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)s);
+		__m256i b = _mm256_loadu_si256((const __m256i*)(s + 32));
+		__m256i c = _mm256_loadu_si256((const __m256i*)(s + 64));
+		__m256i e = _mm256_loadu_si256((const __m256i*)(s + 96));
+		_mm256_stream_si256((__m256i*)d, a);
+		_mm256_stream_si256((__m256i*)(d + 32), b);
+		_mm256_stream_si256((__m256i*)(d + 64), c);
+		_mm256_stream_si256((__m256i*)(d + 96), e);
+	}
+
+	for(; n >= 32; d += 32, s += 32, n -= 32)
+		_mm256_stream_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
+
+	memcpy(d, s, n);
+	_mm_sfence();
+
+	return dest;
+}
+
+#endif
+
+static mlsp_copy_function mlsp_copy_select(int nontemporal)
+{
+	if(!nontemporal)
+		return memcpy;
+
+#ifdef MLSP_X86_STREAMING_STORES
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx2"))
+		return mlsp_copy_avx2_nontemporal;
+	if(__builtin_cpu_supports("sse2"))
+		return mlsp_copy_sse2_nontemporal;
+#endif
+
+	fprintf(stderr, "mlsp: streaming stores not supported, falling back to memcpy\n");
+	return memcpy;
+}
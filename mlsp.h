@@ -24,39 +24,170 @@ enum MLSP_COMPILE_TIME_CONSTANTS
 };
 
 struct mlsp;
+struct mlsp_frame;
+
+enum mlsp_backend_enum
+{
+	MLSP_BACKEND_SOCKET=0, //!< plain socket calls
+	MLSP_BACKEND_IO_URING=1, //!< io_uring batched sends and multishot receive (Linux 6.0+)
+	MLSP_BACKEND_AF_XDP=2, //!< receiver: AF_XDP socket in copy mode on interface queue (Linux 5.9+, CAP_NET_ADMIN, CAP_BPF)
+	MLSP_BACKEND_PACKET_RING=3, //!< receiver: AF_PACKET TPACKET_V3 ring with port filter (Linux 4.20+, CAP_NET_RAW)
+};
+
+//called from mlsp_receive whenever in-order prefix of subframe grows
+//prefix data is valid until the frame is handed out or discarded
+typedef void (*mlsp_prefix_callback)(const struct mlsp_frame *prefix, void *user);
 
 struct mlsp_config
 {
-	const char *ip; //!< IP (send to or listen on) or NULL and "\0" for server (listen on any)
+	const char *ip; //!< IP (send to or listen on) or NULL and "\0" for server (listen on any), multicast group address joins group
 	uint16_t port; //!< port to listen on (server) or send to (client)
-	int timeout_ms; //!< 0 or positive number of ms
+	int timeout_ms; //!< 0 or positive number of ms (without packets), timeout doesn't reset stream state
 	int subframes; //!< number of logical subframes carried by single frame, 0 is treated as 1
+	int nontemporal; //!< receiver: non-zero to place payload with streaming stores (bypassing CPU cache) if CPU supports it
+	int partial_frames; //!< receiver: non-zero to deliver incomplete frames (with loss map) instead of discarding them
+	mlsp_prefix_callback prefix_callback; //!< receiver: NULL or progressive delivery of contiguous subframe prefixes
+	void *prefix_user; //!< receiver: user data passed to prefix_callback
+	int deadline_ms; //!< receiver: 0 or ms from the first packet after which incomplete frame is dropped (or handed out partially)
+	int weights[MLSP_MAX_SUBFRAMES]; //!< sender: packets of subframe sent per round by mlsp_send_frame, 0 is treated as 1
+	int subframe_delivery; //!< receiver: non-zero to return single subframes from mlsp_receive as soon as they complete
+	int independent_subframes; //!< non-zero if each subframe has its own framenumber sequence (e.g. different rates), implies subframe_delivery
+	int zerocopy; //!< sender: non-zero to send with MSG_ZEROCOPY (Linux), see mlsp_zerocopy_wait
+	int backend; //!< I/O backend, mlsp_backend_enum, MLSP_BACKEND_SOCKET by default
+	const char *interface; //!< network interface name for MLSP_BACKEND_AF_XDP, optional for MLSP_BACKEND_PACKET_RING and multicast
+	int queue; //!< receiver: interface receive queue for MLSP_BACKEND_AF_XDP
+	int kernel_filter; //!< receiver: non-zero to drop malformed and stale packets in kernel with eBPF socket filter (Linux 5.5+)
+	int busy_poll_us; //!< receiver: 0 or us of kernel busy polling of device queue on blocking receive (SO_BUSY_POLL)
+	int spin_us; //!< receiver: 0 or us of non-blocking receive spinning before falling back to blocking
+	int pin_cpu; //!< receiver: non-zero to pin the thread calling mlsp_init_server (not other threads) to cpu
+	int cpu; //!< receiver: CPU number for pin_cpu
+	uint32_t max_frame_size; //!< 0 or maximum size of subframe, with frame_rate sizes socket buffers
+	int frame_rate; //!< 0 or frames per second, socket buffers hold 100 ms of stream (at least 2 frames)
+	int multicast_ttl; //!< sender: 0 (default 1) or TTL of multicast packets
+	int multicast_no_loop; //!< sender: non-zero to not deliver multicast packets to receivers on sending host
+	const char *source; //!< receiver: NULL or sender address for source-specific multicast
+	const char *const *destinations; //!< sender/relay: NULL or "ip" or "ip:port" addresses to send each packet to (instead of ip, port is default)
+	int destinations_count; //!< sender/relay: number of destinations
+	const char *const *paths; //!< sender: NULL or local addresses ("ip") or interface names to send through, socket per path
+	int paths_count; //!< sender: number of paths
+	uint32_t redundant_subframes; //!< sender with paths: bitmask of subframes sent through all paths, packets of other subframes alternate paths
+	const uint16_t *ports; //!< receiver: NULL or additional ports to listen on, packets of all ports are merged into single stream
+	int ports_count; //!< receiver: number of additional ports
+	int report_ms; //!< receiver: 0 or interval of reports sent back to sender (socket backends)
+	uint32_t start_bitrate; //!< sender: 0 (default 1 Mbit/s) or initial bandwidth estimate (bits/s)
+	uint32_t min_bitrate; //!< sender: 0 (default 100 kbit/s) or the lowest bandwidth estimate (bits/s)
+	uint32_t max_bitrate; //!< sender: 0 (unlimited) or the highest bandwidth estimate (bits/s)
+	int ping_ms; //!< sender: 0 or interval of pings measuring round trip time and clock offset
+	int skip_frames; //!< sender: non-zero to never block on full socket buffer, frame is skipped instead (socket backend)
 };
 
 enum mlsp_retval_enum
 {
+	MLSP_SKIPPED=-3, //!< sender: frame (or its rest) not sent, socket buffer is full
 	MLSP_TIMEOUT=-2, //!< timeout on receive
 	MLSP_ERROR=-1, //!< error occured
 	MLSP_OK=0, //!< succesfull execution
 };
 
-//user level logical frame to send
+//user level logical frame to send or received
 struct mlsp_frame
 {
 	uint8_t *data;
 	uint32_t size;
+	uint64_t timestamp; //!< sender: 0 (current time) or user timestamp (e.g. capture time in us), receiver: as sent
+	//receiver side only, filled by library
+	uint16_t framenumber; //!< frame this subframe belongs to
+	uint8_t subframe; //!< subframe index in frame
+	uint16_t packets; //!< total packets of subframe, 0 if nothing was received
+	uint16_t collected_packets; //!< received packets, lower than packets for partial frame (prefix packets for prefix)
+	const uint8_t *received_packets; //!< per packet flags (1 received, 0 lost), packets long
+	uint32_t kernel_drops; //!< packets dropped by kernel (socket buffer overflow) while frame was assembled
+	uint32_t duplicate_packets; //!< duplicate copies of packets ignored while frame was assembled (redundant paths or ports)
+	uint32_t late_packets; //!< packets of older frames ignored while frame was assembled (slower port or path, reordering)
+};
+
+//receiver statistics sent back to sender, counters since receiver start
+//frames are counted per subframe
+struct mlsp_report
+{
+	uint64_t timestamp; //!< receiver time of report (us)
+	uint32_t received_packets; //!< packets received
+	uint32_t lost_packets; //!< packets missing in frames that were not completed
+	uint32_t completed_frames; //!< frames received complete
+	uint32_t dropped_frames; //!< frames not completed or not received at all
+	uint32_t jitter_us; //!< interarrival jitter of frames (RFC 3550)
+	uint16_t framenumber; //!< the newest framenumber received
+	uint64_t received_bytes; //!< bytes of packets received (with MLSP header)
+	int64_t min_transit_us; //!< the lowest frame arrival time minus sender send time since the previous report (includes clock offset)
+};
+
+//ping/pong estimate of sample with the lowest round trip time
+struct mlsp_clock
+{
+	int64_t offset_us; //!< receiver clock minus sender clock
+	uint32_t rtt_us; //!< round trip time, 0 if not known yet
+};
+
+//byte range of data missing in partial frame
+struct mlsp_hole
+{
+	uint32_t offset;
+	uint32_t size;
 };
 
 struct mlsp *mlsp_init_client(const struct mlsp_config *config);
 struct mlsp *mlsp_init_server(const struct mlsp_config *config);
+//server configuration (ip, port to listen on) with destinations to forward to
+struct mlsp *mlsp_init_relay(const struct mlsp_config *config);
 void mlsp_close(struct mlsp *m);
 
 int mlsp_send(struct mlsp *m, const struct mlsp_frame *frame, uint8_t subframe);
 
+//sends all subframes of frame at once, interleaving packets of subframes
+//in rounds, each subframe sends up to its weight packets per round
+//high weight (e.g. 65535) gives subframe strict priority
+int mlsp_send_frame(struct mlsp *m, const struct mlsp_frame *frame, int subframes);
+
+//sender with skip_frames: mlsp_send and mlsp_send_frame return MLSP_SKIPPED instead of blocking
+//when frame doesn't fit in socket send buffer, the rest of frame is not sent and the next frame
+//gets new framenumber, returns the number of skipped frames
+//frames larger than socket send buffer are partially sent at best, set max_frame_size to size the buffer
+uint32_t mlsp_get_skipped_frames(const struct mlsp *m);
+
+//zerocopy sender: kernel references frame data after mlsp_send returns
+//waits up to timeout_ms (0 to check, -1 infinite) until all sent data is released
+//returns MLSP_OK when buffers passed to mlsp_send may be reused or freed, MLSP_TIMEOUT otherwise
+int mlsp_zerocopy_wait(struct mlsp *m, int timeout_ms);
+
+//sender: reads reports of receivers with report_ms without blocking, fills the latest one (of any receiver)
+//returns MLSP_OK if new report arrived since the last call, MLSP_TIMEOUT otherwise or MLSP_ERROR
+int mlsp_get_report(struct mlsp *m, struct mlsp_report *report);
+
+//sender with ping_ms and its receiver: round trip time and clock offset
+//one-way latency of frame on receiver is (receive time - timestamp - offset_us)
+//returns MLSP_OK if estimate is available, MLSP_TIMEOUT otherwise or MLSP_ERROR
+int mlsp_get_clock(struct mlsp *m, struct mlsp_clock *clock);
+
+//sender: bandwidth estimate from receiver reports (delay gradient and loss based), bits/s
+//reads pending reports without blocking, start_bitrate until receiver reports arrive
+//with multiple receivers (destinations, multicast) follows the slowest one
+uint32_t mlsp_get_target_bitrate(struct mlsp *m);
+
 //non NULL on success, NULL on failure or timeout
 //the ownership of mlsp_packet remains with library
+//returns array of subframes or single subframe with subframe_delivery
 const struct mlsp_frame *mlsp_receive(struct mlsp *m, int *error);
 
+//fills up to max_holes byte ranges missing in received (partial) frame
+//returns the total number of holes which may be greater than max_holes
+//the content of holes in frame data is undefined
+int mlsp_frame_holes(const struct mlsp_frame *frame, struct mlsp_hole *holes, int max_holes);
+
+//forwards received packets to relay destinations as they arrive, without reassembly
+//waits (up to timeout_ms) for at least one packet, drops malformed and stale packets
+//returns the number of forwarded packets, MLSP_TIMEOUT or MLSP_ERROR
+int mlsp_relay(struct mlsp *m);
+
 #ifdef __cplusplus
 }
 #endif